@@ -0,0 +1,63 @@
+/******************************************************************************
+ * File:             bench-binomial.cpp
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      A microbenchmark comparing `rBinomial` against
+ *                   `std::binomial_distribution` over the counts seen at each
+ *                   depth of the tree. The root of a tree sampling an
+ *                   election of N ballots splits N ballots, while a node at
+ *                   depth d typically splits about N / (nCandidates)^d.
+ *
+ *                   Build and run from the repository root with:
+ *
+ *                   g++ -O2 -std=c++17 -Isrc bench/bench-binomial.cpp \
+ *                     src/distributions.cpp src/prng.cpp -o bench-binomial
+ *                   ./bench-binomial
+ *****************************************************************************/
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "distributions.h"
+#include "prng.h"
+
+// The number of samples drawn for each (n, p) pair.
+constexpr unsigned nSamples = 1000000;
+
+// Returns the throughput of a sampler in millions of samples per second.
+template <typename Sampler>
+double throughput(Sampler sample) {
+  auto start = std::chrono::steady_clock::now();
+  unsigned long long sink = 0;
+  for (unsigned i = 0; i < nSamples; ++i) sink += sample();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  // Prevent the loop from being optimised away.
+  if (sink == 1) std::printf(" ");
+  return nSamples / elapsed.count() / 1e6;
+}
+
+int main() {
+  std::vector<unsigned> ns{1, 10, 100, 1000, 10000, 100000, 1000000};
+  std::vector<double> ps{0.5, 0.1, 0.01};
+  PRNG engine(42);
+
+  std::printf("%10s %6s %12s %12s %8s\n", "n", "p", "std (M/s)",
+              "rBinomial", "speedup");
+  for (unsigned n : ns) {
+    for (double p : ps) {
+      double stdRate = throughput([&]() {
+        // The distribution is constructed per draw, as `rMultinomial` did.
+        std::binomial_distribution<unsigned> b(n, p);
+        return b(engine);
+      });
+      double ownRate = throughput([&]() { return rBinomial(n, p, &engine); });
+      std::printf("%10u %6.2f %12.2f %12.2f %7.2fx\n", n, p, stdRate, ownRate,
+                  ownRate / stdRate);
+    }
+  }
+  return 0;
+}
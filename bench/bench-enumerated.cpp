@@ -0,0 +1,86 @@
+/******************************************************************************
+ * File:             bench-enumerated.cpp
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      A benchmark comparing the two ways of sampling ballots
+ *                   from a flattened Dirichlet-tree which reduces to a
+ *                   Dirichlet distribution: visiting each node, or a single
+ *                   Dirichlet-multinomial draw over every valid ballot. The
+ *                   tree is first updated with a set of random ballots.
+ *
+ *                   Build and run from the repository root with:
+ *
+ *                   g++ -O2 -std=c++17 -Isrc bench/bench-enumerated.cpp \
+ *                     src/irv_flat_tree.cpp src/irv_node.cpp \
+ *                     src/irv_ballot.cpp src/distributions.cpp \
+ *                     src/irv_tabulator.cpp src/prng.cpp src/arena.cpp \
+ *                     -o bench-enumerated
+ *                   ./bench-enumerated
+ *****************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "arena.h"
+#include "irv_flat_tree.h"
+#include "irv_node.h"
+#include "prng.h"
+
+// The number of draws timed for each configuration.
+constexpr unsigned nDraws = 200;
+
+// Returns the number of draws of n ballots per second, either from the
+// enumerated ballots or by visiting each node of a tree which does not
+// enumerate them.
+double drawsPerSecond(const FlatIRVTree &flat, bool enumerated, unsigned n,
+                      IRVParameters *params, PRNG *engine) {
+  SampleBuffer<IRVBallot> buffer;
+  buffer.reserveDepths(params->getNCandidates() + 1);
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < nDraws; ++i) {
+    buffer.clear();
+    buffer.path = params->defaultPath();
+    if (enumerated) {
+      flat.sampleEnumerated(n, buffer.path, buffer, engine);
+    } else {
+      flat.sample(n, buffer.path, buffer, engine);
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return nDraws / elapsed.count();
+}
+
+int main() {
+  PRNG engine(12345);
+  std::printf("%-12s %-10s %-10s %12s %12s\n", "candidates", "ballots",
+              "valid", "tree (/s)", "enum (/s)");
+  for (unsigned nCandidates = 4; nCandidates <= 8; ++nCandidates) {
+    IRVParameters params(nCandidates, 0, nCandidates, 1., true);
+    Arena arena;
+    IRVNode *root = IRVNode::create(0, &params, &arena);
+
+    // Observe 1000 random ballots of random length.
+    std::vector<unsigned> path = params.defaultPath();
+    for (unsigned i = 0; i < 1000; ++i) {
+      std::vector<unsigned> prefs = params.defaultPath();
+      std::shuffle(prefs.begin(), prefs.end(), engine);
+      prefs.resize(1 + engine() % nCandidates);
+      root->update(IRVBallot(prefs), path, 1, &arena);
+    }
+
+    FlatIRVTree tree, enumerated;
+    tree.build(root, &params, false);
+    enumerated.build(root, &params);
+
+    for (unsigned n : {100u, 1000u, 10000u, 100000u}) {
+      std::printf("%-12u %-10u %-10zu %12.1f %12.1f\n", nCandidates, n,
+                  enumerated.getNEnumerated(),
+                  drawsPerSecond(tree, false, n, &params, &engine),
+                  drawsPerSecond(enumerated, true, n, &params, &engine));
+    }
+  }
+}
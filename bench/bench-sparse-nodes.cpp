@@ -0,0 +1,85 @@
+/******************************************************************************
+ * File:             bench-sparse-nodes.cpp
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      A benchmark of the memory used by the nodes of an IRV
+ *                   Dirichlet-tree with many candidates, where wide nodes
+ *                   store only their observed branches, compared with the
+ *                   memory the same nodes would use if every branch was
+ *                   stored. Candidate c is preferred with weight 1 / (c + 1),
+ *                   so a few candidates receive most preferences as in a
+ *                   Senate-style contest.
+ *
+ *                   Build and run from the repository root with:
+ *
+ *                   g++ -O2 -std=c++17 -Isrc bench/bench-sparse-nodes.cpp \
+ *                     src/irv_node.cpp src/irv_ballot.cpp src/irv_tabulator.cpp \
+ *                     src/distributions.cpp src/prng.cpp src/arena.cpp \
+ *                     -o bench-sparse-nodes
+ *                   ./bench-sparse-nodes
+ *****************************************************************************/
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "arena.h"
+#include "irv_node.h"
+#include "prng.h"
+
+// Counts the nodes of a tree, and the bytes they would use if every branch
+// was stored.
+void denseSize(const IRVNode *node, unsigned nChildren, size_t *nNodes,
+               size_t *nBytes) {
+  ++*nNodes;
+  *nBytes += sizeof(IRVNode) + (nChildren + 1) * sizeof(double) +
+             nChildren * sizeof(IRVNode *);
+  for (unsigned i = 0; i < nChildren; ++i) {
+    const IRVNode *child = node->getChild(i);
+    if (child != nullptr) denseSize(child, nChildren - 1, nNodes, nBytes);
+  }
+}
+
+int main() {
+  PRNG engine(12345);
+  std::printf("%-12s %-10s %-10s %14s %14s %10s\n", "candidates", "ballots",
+              "nodes", "dense (MB)", "sparse (MB)", "update (s)");
+  for (unsigned nCandidates : {20u, 50u, 100u}) {
+    std::vector<double> weights(nCandidates);
+    for (unsigned c = 0; c < nCandidates; ++c) weights[c] = 1. / (c + 1);
+    for (unsigned n : {10000u, 100000u}) {
+      IRVParameters params(nCandidates, 0, nCandidates);
+      Arena arena;
+      IRVNode *root = IRVNode::create(0, &params, &arena);
+      std::vector<unsigned> path = params.defaultPath();
+
+      // Draw ballots of 1 to 6 preferences without replacement.
+      std::vector<IRVBallot> ballots;
+      for (unsigned i = 0; i < n; ++i) {
+        std::vector<double> w = weights;
+        std::vector<unsigned> prefs;
+        unsigned length = 1 + engine() % 6;
+        while (prefs.size() < length) {
+          std::discrete_distribution<unsigned> pick(w.begin(), w.end());
+          unsigned c = pick(engine);
+          prefs.push_back(c);
+          w[c] = 0.;
+        }
+        ballots.emplace_back(prefs);
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      for (const IRVBallot &b : ballots) root->update(b, path, 1, &arena);
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+
+      size_t nNodes = 0, nBytes = 0;
+      denseSize(root, nCandidates, &nNodes, &nBytes);
+      std::printf("%-12u %-10u %-10zu %14.2f %14.2f %10.3f\n", nCandidates, n,
+                  nNodes, nBytes / 1e6, arena.getNBytes() / 1e6,
+                  elapsed.count());
+    }
+  }
+}
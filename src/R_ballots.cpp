@@ -0,0 +1,47 @@
+/******************************************************************************
+ * File:             R_ballots.cpp
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      This file implements the conversion of ballots from R as
+ *                   outlined in `R_ballots.h`.
+ *****************************************************************************/
+
+#include "R_ballots.h"
+
+std::vector<IRVBallotCount> parseBallotMatrix(
+    const Rcpp::IntegerMatrix &ballots, const Rcpp::IntegerVector &counts,
+    unsigned nCandidates) {
+  unsigned nBallots = ballots.nrow(), nPreferences = ballots.ncol();
+  if (counts.size() != nBallots)
+    Rcpp::stop("`counts` must have one entry for each ballot.");
+
+  std::vector<IRVBallotCount> out;
+  out.reserve(nBallots);
+
+  // The preferences of the current ballot, and the last ballot in which each
+  // candidate appeared, for detecting repeated candidates.
+  std::vector<unsigned> indexPrefs;
+  indexPrefs.reserve(nPreferences);
+  std::vector<unsigned> lastSeen(nCandidates, 0);
+
+  for (unsigned i = 0; i < nBallots; ++i) {
+    if (counts[i] == NA_INTEGER || counts[i] < 0)
+      Rcpp::stop("Ballot counts must be non-negative integers.");
+    if (counts[i] == 0) continue;
+    indexPrefs.clear();
+    for (unsigned j = 0; j < nPreferences; ++j) {
+      int c = ballots(i, j);
+      if (c == NA_INTEGER) break;
+      if (c < 1 || static_cast<unsigned>(c) > nCandidates)
+        Rcpp::stop("Unknown candidate encountered in ballot!");
+      if (lastSeen[c - 1] == i + 1)
+        Rcpp::stop("A candidate appears more than once in a ballot.");
+      lastSeen[c - 1] = i + 1;
+      indexPrefs.push_back(c - 1);
+    }
+    out.emplace_back(IRVBallot(indexPrefs), counts[i]);
+  }
+
+  return out;
+}
@@ -0,0 +1,40 @@
+/******************************************************************************
+ * File:             R_ballots.h
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      This file declares the conversion of ballots from their
+ *                   R representation. Ballots are passed from R as an integer
+ *                   matrix of candidate indices, which is read in place
+ *                   without converting candidate names.
+ *****************************************************************************/
+
+#ifndef R_BALLOTS_H
+#define R_BALLOTS_H
+
+#include <Rcpp.h>
+
+#include <vector>
+
+#include "irv_ballot.h"
+
+/*! \brief Converts an R matrix of ballots to a std::vector<IRVBallotCount>.
+ *
+ *  Each row of the matrix is a ballot, and each column a preference, holding
+ * the 1-based index of the candidate given that preference. A ballot ends at
+ * its' first NA, so ballots of any length can share a matrix. Rows with a
+ * count of zero are skipped.
+ *
+ * \param ballots An integer matrix of ballots.
+ *
+ * \param counts The number of times each ballot was cast.
+ *
+ * \param nCandidates The number of candidates.
+ *
+ * \return A vector of IRVBallotCount objects.
+ */
+std::vector<IRVBallotCount> parseBallotMatrix(
+    const Rcpp::IntegerMatrix &ballots, const Rcpp::IntegerVector &counts,
+    unsigned nCandidates);
+
+#endif /* R_BALLOTS_H */
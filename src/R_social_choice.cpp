@@ -13,54 +13,19 @@
 // [[Rcpp::depends(RcppThread)]]
 
 // [[Rcpp::export]]
-Rcpp::List social_choice_irv(Rcpp::List bs, unsigned nWinners,
+Rcpp::List social_choice_irv(Rcpp::IntegerMatrix bs, Rcpp::IntegerVector counts,
+                             unsigned nWinners,
                              Rcpp::CharacterVector candidates,
                              std::string seed) {
   Rcpp::List out{};
 
-  std::list<IRVBallotCount> scInput{};
+  std::vector<std::string> cNames(candidates.begin(), candidates.end());
 
-  std::unordered_map<std::string, size_t> c2Index{};
-  std::vector<std::string> cNames{};
-  // If candidates vector is not null, initialze some indices.
-  std::string cName;
-  for (const auto &candidate : candidates) {
-    cName = candidate;
-    if (c2Index.count(cName) == 0) {
-      c2Index[cName] = cNames.size();
-      cNames.push_back(cName);
-    }
-  }
-
-  Rcpp::CharacterVector bNames;
-  std::list<unsigned> bIndices;
-  bool newBallot = true;
-
-  for (auto i = 0; i < bs.size(); ++i) {
-    if (bs[i] == R_NilValue)  // Skip empty ballots
-      continue;
-    bNames = bs[i];
-    bIndices = {};
-    for (auto j = 0; j < bNames.size(); ++j) {
-      cName = bNames[j];
-      // If candidate has not yet been seen, raise an error.
-      if (c2Index.count(cName) == 0)
-        Rcpp::stop("Invalid candidate found during social-choice evaluation.");
-      bIndices.push_back(c2Index[cName]);
-    }
-
-    // Search for the same ballot already in the social choice input.
-    IRVBallot b(bIndices);
-    newBallot = true;
-    for (auto &bc : scInput) {
-      if (b == bc.first) {
-        bc.second = bc.second + 1;
-        newBallot = false;
-      }
-    }
-    // If it's not already there, add it to the back of the list with count 1.
-    if (newBallot) scInput.emplace_back(std::move(b), 1);
-  }
+  // Aggregate equal ballots, skipping empty ballots.
+  OutcomeTable<IRVBallot> aggregated{};
+  for (const IRVBallotCount &bc : parseBallotMatrix(bs, counts, cNames.size()))
+    if (bc.first.nPreferences() > 0) aggregated.add(bc.first, bc.second);
+  std::vector<IRVBallotCount> scInput = aggregated.release();
 
   if (nWinners < 1 || nWinners >= cNames.size())
     Rcpp::stop("`nWinners` must be >= 1 and <= the number of candidates.");
@@ -70,8 +35,8 @@ Rcpp::List social_choice_irv(Rcpp::List bs, unsigned nWinners,
 
   // Seed the PRNG.
   std::seed_seq ss(seed.begin(), seed.end());
-  std::mt19937 e(ss);
-  e.discard(e.state_size * 100);
+  PRNG e(ss);
+  e.discard(std::mt19937::state_size * 100);
 
   // Group all equal ballots
 
@@ -13,14 +13,20 @@
 #include <R.h>
 #include <Rcpp.h>
 
+#include "R_ballots.h"
 #include "irv_ballot.h"
+#include "outcome_table.h"
 
 /*! \brief The IRV social choice function.
  *
  *  This function calculates an election outcome using the standard IRV social
  * choice function.
  *
- * \param  bs An Rcpp::List of ballots in CharacterVector representation.
+ * \param bs An integer matrix of ballots, with one row for each ballot and
+ * one column for each preference. Each entry is the 1-based index of a
+ * candidate, and each ballot ends at its' first NA.
+ *
+ * \param counts The number of times each ballot was cast.
  *
  * \param nWinners An integer indicating the number of winners to elect.
  *
@@ -30,7 +36,8 @@
  *
  * \return The winning candidate.
  */
-Rcpp::List social_choice_irv(Rcpp::List bs, unsigned nWinners,
+Rcpp::List social_choice_irv(Rcpp::IntegerMatrix bs, Rcpp::IntegerVector counts,
+                             unsigned nWinners,
                              Rcpp::CharacterVector candidates,
                              std::string seed);
 
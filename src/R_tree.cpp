@@ -10,49 +10,61 @@
 
 #include "R_tree.h"
 
-std::list<IRVBallotCount> RDirichletTree::parseBallotList(Rcpp::List bs) {
-  Rcpp::CharacterVector namePrefs;
-  std::string cName;
-  std::list<unsigned> indexPrefs;
-  size_t cIndex;
-
-  std::list<IRVBallotCount> out;
-
-  // We iterate over each ballot, and convert it into an IRVBallotCount using
-  // the "candidate index" for each seen candidate.
-  for (auto i = 0; i < bs.size(); ++i) {
-    namePrefs = bs[i];
-    indexPrefs = {};
-    for (auto j = 0; j < namePrefs.size(); ++j) {
-      cName = namePrefs[j];
-
-      // Find index for the candidate. Add it to our set if it doesn't exist.
-      if (candidateMap.count(cName) == 0) {
-        Rcpp::stop("Unknown candidate encountered in ballot!");
-      } else {
-        cIndex = candidateMap[cName];
-      }
-
-      indexPrefs.push_back(cIndex);
-    }
-    out.emplace_back(std::move(indexPrefs), 1);
-  }
+// The names of the PRNG engines available from R.
+static const std::pair<const char *, PRNG::Kind> engineNames[] = {
+    {"mt19937", PRNG::Kind::MT19937},
+    {"xoshiro256++", PRNG::Kind::Xoshiro256pp},
+    {"pcg64", PRNG::Kind::PCG64},
+    {"philox", PRNG::Kind::Philox4x32}};
 
-  return out;
+// The number of elections between checks of the adaptive stopping rules.
+static constexpr unsigned adaptiveRoundSize = 1000;
+
+/*! \brief Checks whether adaptive posterior sampling can stop.
+ *
+ *  Each candidate's win probability is given a Beta(wins + 1/2, losses + 1/2)
+ * posterior (the Jeffreys prior), and sampling stops once every posterior
+ * standard deviation is below the tolerance, or once the equal-tailed credible
+ * interval of the leading candidate lies entirely above or below the
+ * threshold. The rules are checked after every round without any correction
+ * for the repeated looks.
+ *
+ * \param wins The number of wins for each candidate.
+ *
+ * \param n The number of elections simulated.
+ *
+ * \param tolerance The standard deviation to reach, or 0 to disable.
+ *
+ * \param threshold The threshold to compare the leading candidate with, or a
+ * negative value to disable.
+ *
+ * \param alpha The posterior probability outside the credible interval.
+ *
+ * \return Whether sampling can stop.
+ */
+static bool converged(const std::vector<uint64_t> &wins, uint64_t n,
+                      double tolerance, double threshold, double alpha) {
+  double maxSD = 0;
+  uint64_t leaderWins = 0;
+  for (uint64_t w : wins) {
+    double a = w + 0.5, b = n - w + 0.5;
+    double sd = std::sqrt(a * b / ((a + b) * (a + b) * (a + b + 1)));
+    maxSD = std::max(maxSD, sd);
+    leaderWins = std::max(leaderWins, w);
+  }
+  if (tolerance > 0 && maxSD < tolerance) return true;
+  if (threshold < 0) return false;
+  double a = leaderWins + 0.5, b = n - leaderWins + 0.5;
+  double lower = R::qbeta(alpha / 2, a, b, true, false);
+  double upper = R::qbeta(alpha / 2, a, b, false, false);
+  return lower > threshold || upper < threshold;
 }
 
 RDirichletTree::RDirichletTree(Rcpp::CharacterVector candidates,
                                unsigned minDepth_, unsigned maxDepth_,
                                double a0_, bool vd_, std::string seed_) {
-  // Parse the candidate strings.
-  std::string cName;
-  size_t cIndex = 0;
-  for (auto i = 0; i < candidates.size(); ++i) {
-    cName = candidates[i];
-    candidateVector.push_back(cName);
-    candidateMap[cName] = cIndex;
-    ++cIndex;
-  }
+  // Ballots refer to candidates by their index in this vector.
+  candidateVector = Rcpp::clone(candidates);
   // Initialize tree.
   IRVParameters *params =
       new IRVParameters(candidates.size(), minDepth_, maxDepth_, a0_, vd_);
@@ -77,9 +89,32 @@ unsigned RDirichletTree::getMaxDepth() {
 }
 double RDirichletTree::getA0() { return tree->getParameters()->getA0(); }
 bool RDirichletTree::getVD() { return tree->getParameters()->getVD(); }
+std::string RDirichletTree::getEngine() {
+  PRNG::Kind kind = tree->getEnginePtr()->getKind();
+  for (const auto &[name, kind_] : engineNames) {
+    if (kind_ == kind) return name;
+  }
+  return "";
+}
 Rcpp::CharacterVector RDirichletTree::getCandidates() {
-  Rcpp::CharacterVector out{};
-  for (const auto &[candidate, idx] : candidateMap) out.push_back(candidate);
+  return candidateVector;
+}
+Rcpp::List RDirichletTree::getThreadStats() {
+  const std::vector<WorkerStats> &stats = pool.getStats();
+  double wall = pool.getWallSeconds();
+  Rcpp::NumericVector elections(stats.size()), steals(stats.size()),
+      busy(stats.size()), utilisation(stats.size());
+  for (unsigned i = 0; i < stats.size(); ++i) {
+    elections[i] = stats[i].tasks;
+    steals[i] = stats[i].steals;
+    busy[i] = stats[i].busySeconds;
+    utilisation[i] = wall > 0 ? stats[i].busySeconds / wall : 0;
+  }
+  Rcpp::List out{};
+  out("elections") = elections;
+  out("steals") = steals;
+  out("busy_seconds") = busy;
+  out("utilisation") = utilisation;
   return out;
 }
 
@@ -109,11 +144,29 @@ void RDirichletTree::setMaxDepth(unsigned maxDepth_) {
   if (maxDepth_ < tree->getParameters()->getMinDepth())
     Rcpp::stop("Cannot set `maxDepth` to a value less than `minDepth`.");
   tree->getParameters()->setMaxDepth(maxDepth_);
+  tree->invalidate();
+}
+
+void RDirichletTree::setA0(double a0_) {
+  tree->getParameters()->setA0(a0_);
+  tree->invalidate();
 }
 
-void RDirichletTree::setA0(double a0_) { tree->getParameters()->setA0(a0_); }
+void RDirichletTree::setEngine(std::string engine_) {
+  for (const auto &[name, kind] : engineNames) {
+    if (name == engine_) {
+      tree->setEngine(kind);
+      return;
+    }
+  }
+  Rcpp::stop("`engine` must be one of \"mt19937\", \"xoshiro256++\", "
+             "\"pcg64\" or \"philox\".");
+}
 
-void RDirichletTree::setVD(bool vd_) { tree->getParameters()->setVD(vd_); }
+void RDirichletTree::setVD(bool vd_) {
+  tree->getParameters()->setVD(vd_);
+  tree->invalidate();
+}
 
 // Other methods
 void RDirichletTree::reset() {
@@ -122,12 +175,14 @@ void RDirichletTree::reset() {
   observedDepths.clear();
 }
 
-void RDirichletTree::update(Rcpp::List ballots) {
+void RDirichletTree::update(Rcpp::IntegerMatrix ballots,
+                            Rcpp::IntegerVector counts) {
   // For checking validitity of inputs.
   unsigned minDepth = tree->getParameters()->getMinDepth();
   unsigned depth;
   // Parse the ballots.
-  std::list<IRVBallotCount> bcs = parseBallotList(ballots);
+  std::vector<IRVBallotCount> bcs =
+      parseBallotMatrix(ballots, counts, candidateVector.size());
   for (IRVBallotCount &bc : bcs) {
     // If the tree is reducible to a Dirichlet distribution,
     // we need to check that the observed ballot length is >=
@@ -145,113 +200,211 @@ void RDirichletTree::update(Rcpp::List ballots) {
           "distribution when using the `vd` option. Consider setting "
           "`minDepth` to a value lower than the length of the smallest "
           "ballot.");
-    // Update the tree with count * the ballot.
     nObserved += bc.second;
-    tree->update(bc);
     observedDepths.insert(depth);
   }
+  // Update the tree with all of the ballots at once.
+  tree->update(bcs);
 }
 
 Rcpp::List RDirichletTree::samplePredictive(unsigned nSamples,
                                             std::string seed) {
   tree->setSeed(seed);
-
-  Rcpp::List out;
-  Rcpp::CharacterVector rBallot;
+  tree->compile();
 
   std::list<IRVBallotCount> samples = tree->sample(nSamples);
-  for (auto &[b, count] : samples) {
-    // Push count * b to the list.
-    for (unsigned i = 0; i < count; ++i) {
-      rBallot = Rcpp::CharacterVector::create();
-      for (auto cIndex : b.preferences) {
-        rBallot.push_back(candidateVector[cIndex]);
-      }
-      out.push_back(rBallot);
-    }
+
+  // Each sampled ballot is returned once, as a row of 1-based candidate
+  // indices padded with NA, along with the number of times it was drawn.
+  unsigned nCandidates = getNCandidates();
+  Rcpp::IntegerMatrix ballots(samples.size(), nCandidates);
+  Rcpp::IntegerVector counts(samples.size());
+  std::fill(ballots.begin(), ballots.end(), NA_INTEGER);
+  unsigned i = 0;
+  for (const auto &[b, count] : samples) {
+    for (unsigned j = 0; j < b.nPreferences(); ++j) ballots(i, j) = b[j] + 1;
+    counts[i] = count;
+    ++i;
   }
 
+  Rcpp::List out{};
+  out("ballots") = ballots;
+  out("counts") = counts;
   return out;
 }
 
-Rcpp::NumericVector RDirichletTree::samplePosterior(unsigned nElections,
-                                                    unsigned nBallots,
-                                                    unsigned nWinners,
-                                                    bool replace,
-                                                    unsigned nThreads,
-                                                    std::string seed) {
+PosteriorTally RDirichletTree::simulatePosterior(
+    unsigned nElections, unsigned nBallots, unsigned nWinners, bool replace,
+    unsigned nThreads, std::string seed, double tolerance, double threshold,
+    double alpha, bool summarise) {
   if (nBallots < nObserved)
     Rcpp::stop(
         "`nBallots` must be larger than the number of ballots "
         "observed to obtain the posterior.");
 
   tree->setSeed(seed);
+  // Flatten the tree before sampling from it concurrently.
+  tree->compile();
 
   size_t nCandidates = getNCandidates();
 
-  // Generate PRNG seeds.
-  std::mt19937 *treeGen = tree->getEnginePtr();
-  std::vector<unsigned> seeds{};
-  for (unsigned i = 0; i <= nThreads; ++i) {
-    seeds.push_back((*treeGen)());
-  }
-
-  // The number of elections to sample per batch.
-  unsigned batchSize, batchRemainder;
-  if (nElections <= 1) {
-    batchSize = 0;
-    batchRemainder = nElections;
-  } else {
-    batchSize = nElections / nThreads;
-    batchRemainder = nElections % nThreads;
-  }
-
-  // The results vectors for each thread.
-  std::vector<std::vector<std::vector<unsigned>>> results(nThreads);
-
-  // Use multiple threads to compute the posterior in batches.
-  auto processBatch = [&](size_t thread_idx, size_t size) -> void {
-    // Seed a new PRNG, and warm it up.
-    std::mt19937 e(seeds[thread_idx]);
-    e.discard(e.state_size * 100);
-
-    // Prepare results vector
-    results[thread_idx].resize(size);
-    for (unsigned j = 0; j < size; ++j) {
+  // Derive the seed shared by every election. Election j is simulated with
+  // stream j of this seed, so the result does not depend on how the
+  // elections are divided between threads.
+  PRNG *treeGen = tree->getEnginePtr();
+  uint64_t baseSeed = (uint64_t{(*treeGen)()} << 32) | (*treeGen)();
+
+  // Unless sampling with replacement, every simulated election contains the
+  // observed ballots. They are grouped by first preference once, and shared
+  // between all elections, so that each election only needs to sample and
+  // tally the unobserved ballots.
+  IRVBallotGroups observed(
+      replace ? std::vector<IRVBallotCount>{} : tree->getObserved(),
+      nCandidates);
+  unsigned nUnobserved = replace ? nBallots : nBallots - tree->getNObserved();
+
+  // Each worker reuses its' own PRNG, simulated election storage and
+  // tabulation scratch space across the elections it is given, and tallies
+  // the winners of its' elections separately. The PRNG is of the same kind as
+  // the tree's, and is reseeded for each election.
+  pool.resize(nThreads);
+  std::vector<PRNG> engines(nThreads, PRNG(baseSeed, 0, treeGen->getKind()));
+  std::vector<SampleBuffer<IRVBallot>> elections(nThreads);
+  // A summary requires the complete elimination order and the tallies of each
+  // round, whereas otherwise only the winners are tabulated.
+  std::vector<IRVTabulator> tabulators(nThreads, IRVTabulator(nCandidates));
+  for (IRVTabulator &t : tabulators) t.setRecordTallies(summarise);
+  unsigned nTabulated = summarise ? 0 : nWinners;
+  PosteriorTally total(nCandidates, nWinners, summarise,
+                       summarise ? nBallots : 0);
+  std::vector<PosteriorTally> tallies(nThreads, total);
+
+  // The first election of the current round.
+  unsigned roundStart = 0;
+
+  auto processChunk = [&](unsigned worker, unsigned begin,
+                          unsigned end) -> void {
+    PRNG &e = engines[worker];
+    SampleBuffer<IRVBallot> &election = elections[worker];
+    for (unsigned j = roundStart + begin; j < roundStart + end; ++j) {
       // Check for interrupt.
       RcppThread::checkUserInterrupt();
-      // Simulate election.
-      std::list<IRVBallotCount> election = tree->posteriorSet(nBallots, replace, &e);
+      e.seedStream(baseSeed, j);
+      // Simulate the unobserved ballots of the election.
+      election.clear();
+      tree->sample(nUnobserved, election, &e);
       // Evaluate social choice function.
-      results[thread_idx][j] =
-          socialChoiceIRV(election, nCandidates, &e);
+      IRVTabulator &tabulator = tabulators[worker];
+      tallies[worker].add(
+          tabulator.tabulate(observed, election.outcomes, &e, nTabulated),
+          &tabulator.getRoundTallies());
     }
   };
 
-  // Dispatch the jobs
-  std::vector<std::thread> pool(nThreads - 1);
-  // last batch should run on head process
-  for (unsigned i = 0; i < nThreads - 1; ++i) {
-    pool[i] = std::thread(std::bind(processBatch, i, batchSize + (i < batchRemainder)));
+  // When stopping adaptively, the elections are run in rounds of a fixed size
+  // so that the number of elections used does not depend on the number of
+  // threads. Otherwise, every election is run in a single round.
+  bool adaptive = tolerance > 0 || threshold >= 0;
+  unsigned roundSize = adaptive ? adaptiveRoundSize : nElections;
+  while (roundStart < nElections) {
+    unsigned nRound = std::min(roundSize, nElections - roundStart);
+    // Run the elections in small chunks, so that idle workers can steal work
+    // from those which are given more expensive elections.
+    pool.run(nRound, std::max(1u, nRound / (16 * nThreads)), processChunk);
+    roundStart += nRound;
+    // The counts are integers, so merging the tallies in any order gives the
+    // same total.
+    total.clear();
+    for (const PosteriorTally &t : tallies) total.merge(t);
+    if (adaptive &&
+        converged(total.getWins(), roundStart, tolerance, threshold, alpha))
+      break;
   }
 
-  // Process final batch on main process
-  processBatch(nThreads - 1, batchSize);
+  return total;
+}
 
-  // Join the threads
-  std::for_each(pool.begin(), pool.end(), [](std::thread &t) { t.join(); });
+Rcpp::NumericVector RDirichletTree::samplePosterior(
+    unsigned nElections, unsigned nBallots, unsigned nWinners, bool replace,
+    unsigned nThreads, std::string seed, double tolerance, double threshold,
+    double alpha) {
+  PosteriorTally total =
+      simulatePosterior(nElections, nBallots, nWinners, replace, nThreads,
+                        seed, tolerance, threshold, alpha, false);
 
   // Aggregate the results
+  size_t nCandidates = getNCandidates();
+  double n = total.getNElections();
   Rcpp::NumericVector out(nCandidates);
   out.names() = candidateVector;
-  for (unsigned i = 0; i < nThreads; ++i) {
-    for (unsigned j = 0; j < results[i].size(); ++j) {
-      for (unsigned k = nCandidates - nWinners; k < nCandidates; ++k) {
-        out[results[i][j][k]] = out[results[i][j][k]] + 1;
-      }
+  for (unsigned i = 0; i < nCandidates; ++i) {
+    out[i] = total.getWins()[i] / n;
+  }
+  out.attr("n_elections") = n;
+  return out;
+}
+
+Rcpp::List RDirichletTree::samplePosteriorSummary(
+    unsigned nElections, unsigned nBallots, unsigned nWinners, bool replace,
+    unsigned nThreads, std::string seed, Rcpp::NumericVector probs) {
+  PosteriorTally total = simulatePosterior(
+      nElections, nBallots, nWinners, replace, nThreads, seed, 0, -1, 0, true);
+
+  size_t nCandidates = getNCandidates();
+  double n = total.getNElections();
+
+  Rcpp::NumericVector wins(nCandidates);
+  wins.names() = candidateVector;
+  for (unsigned i = 0; i < nCandidates; ++i) {
+    wins[i] = total.getWins()[i] / n;
+  }
+
+  // Sort the elimination orders by decreasing frequency, breaking ties by
+  // the order itself, so that the output does not depend on the order in
+  // which they were first seen.
+  std::vector<std::pair<IRVBallot, unsigned>> orders =
+      total.getOrders().data();
+  std::sort(orders.begin(), orders.end(), [&](const auto &a, const auto &b) {
+    if (a.second != b.second) return a.second > b.second;
+    for (unsigned k = 0; k < nCandidates; ++k) {
+      if (a.first[k] != b.first[k]) return a.first[k] < b.first[k];
+    }
+    return false;
+  });
+  // The orders are returned one after another as 1-based candidate indices.
+  Rcpp::IntegerVector orderIndices(orders.size() * nCandidates);
+  Rcpp::NumericVector orderProbs(orders.size());
+  for (unsigned i = 0; i < orders.size(); ++i) {
+    for (unsigned k = 0; k < nCandidates; ++k)
+      orderIndices[i * nCandidates + k] = orders[i].first[k] + 1;
+    orderProbs[i] = orders[i].second / n;
+  }
+
+  // Column-major, so that element [a, b] of the R matrix is the probability
+  // that a is eliminated before b.
+  Rcpp::NumericVector precedence(nCandidates * nCandidates);
+  for (unsigned a = 0; a < nCandidates; ++a) {
+    for (unsigned b = 0; b < nCandidates; ++b)
+      precedence[a + b * nCandidates] =
+          total.getPrecedence()[a * nCandidates + b] / n;
+  }
+
+  // Column-major, indexed by [round, candidate, quantile].
+  unsigned nRounds = nCandidates - 1;
+  Rcpp::NumericVector quantiles(nRounds * nCandidates * probs.size());
+  for (unsigned q = 0; q < probs.size(); ++q) {
+    for (unsigned c = 0; c < nCandidates; ++c) {
+      for (unsigned r = 0; r < nRounds; ++r)
+        quantiles[r + nRounds * (c + nCandidates * q)] =
+            total.tallyQuantile(r, c, probs[q]);
     }
   }
 
-  out = out / nElections;
+  Rcpp::List out{};
+  out("win_probabilities") = wins;
+  out("orders") = orderIndices;
+  out("order_probabilities") = orderProbs;
+  out("precedence") = precedence;
+  out("tally_quantiles") = quantiles;
   return out;
 }
@@ -14,6 +14,7 @@
 #include <Rcpp.h>
 #include <RcppThread.h>
 
+#include <cmath>
 #include <random>
 #include <thread>
 #include <unordered_map>
@@ -22,7 +23,13 @@
 
 #include "dirichlet_tree.h"
 #include "irv_ballot.h"
+#include "irv_flat_tree.h"
 #include "irv_node.h"
+#include "irv_tabulator.h"
+#include "posterior_tally.h"
+#include "R_ballots.h"
+#include "prng.h"
+#include "thread_pool.h"
 
 /*! \brief An Rcpp object which implements the `dtree` R object interface.
  *
@@ -34,12 +41,9 @@ class RDirichletTree {
   // The underlying Dirichlet-tree.
   DirichletTree<IRVNode, IRVBallot, IRVParameters> *tree;
 
-  // A vector of candidate names.
+  // A vector of candidate names, in order of their ballot index.
   Rcpp::CharacterVector candidateVector{};
 
-  // A map of candidate names to their ballot index.
-  std::unordered_map<std::string, size_t> candidateMap{};
-
   // A record of the number of observed ballots.
   size_t nObserved = 0;
 
@@ -47,19 +51,22 @@ class RDirichletTree {
   // the posterior can reduce to a Dirichlet distribution or not.
   std::unordered_set<unsigned> observedDepths{};
 
-  /*! \brief Converts an R list of valid IRV ballot vectors to a
-   * std::list<IRVBallotCount> format.
-   *
-   *  In R, we consider a matrix of ballots to be that with columns
-   * corresponding to each preference choice, and elements corresponding to the
-   * index of the candidate.
+  // The worker threads used by `samplePosterior`, which persist between calls.
+  ThreadPool pool{};
+
+  /*! \brief Simulates elections from the posterior and tallies the results.
    *
-   * \param bs An Rcpp::List of ballots (assumed to be in Rcpp::CharacterVector
-   * representation).
+   * \param summarise Whether to record the elimination orders and the tallies
+   * of each round, in addition to the winners.
    *
-   * \return A list of IRVBallotCount objects.
+   * \return The merged tally of every simulated election. The remaining
+   * parameters are as for `samplePosterior`.
    */
-  std::list<IRVBallotCount> parseBallotList(Rcpp::List bs);
+  PosteriorTally simulatePosterior(unsigned nElections, unsigned nBallots,
+                                   unsigned nWinners, bool replace,
+                                   unsigned nThreads, std::string seed,
+                                   double tolerance, double threshold,
+                                   double alpha, bool summarise);
 
  public:
   // Constructor
@@ -77,6 +84,8 @@ class RDirichletTree {
   unsigned getMaxDepth();
   double getA0();
   bool getVD();
+  std::string getEngine();
+  Rcpp::List getThreadStats();
   Rcpp::CharacterVector getCandidates();
 
   // Setters
@@ -85,14 +94,21 @@ class RDirichletTree {
   void setA0(double a0_);
   void setSeed(std::string seed_);
   void setVD(bool vd_);
+  void setEngine(std::string engine_);
 
   // Other methods
   void reset();
-  void update(Rcpp::List ballots);
+  void update(Rcpp::IntegerMatrix ballots, Rcpp::IntegerVector counts);
   Rcpp::List samplePredictive(unsigned nSamples, std::string seed);
   Rcpp::NumericVector samplePosterior(unsigned nElections, unsigned nBallots,
                                       unsigned nWinners, bool replace,
-                                      unsigned nThreads, std::string seed);
+                                      unsigned nThreads, std::string seed,
+                                      double tolerance, double threshold,
+                                      double alpha);
+  Rcpp::List samplePosteriorSummary(unsigned nElections, unsigned nBallots,
+                                    unsigned nWinners, bool replace,
+                                    unsigned nThreads, std::string seed,
+                                    Rcpp::NumericVector probs);
 };
 
 #endif /* R_TREE_H */
@@ -12,16 +12,17 @@ Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
 // social_choice_irv
-Rcpp::List social_choice_irv(Rcpp::List bs, unsigned nWinners, Rcpp::CharacterVector candidates, std::string seed);
-RcppExport SEXP _elections_dtree_social_choice_irv(SEXP bsSEXP, SEXP nWinnersSEXP, SEXP candidatesSEXP, SEXP seedSEXP) {
+Rcpp::List social_choice_irv(Rcpp::IntegerMatrix bs, Rcpp::IntegerVector counts, unsigned nWinners, Rcpp::CharacterVector candidates, std::string seed);
+RcppExport SEXP _elections_dtree_social_choice_irv(SEXP bsSEXP, SEXP countsSEXP, SEXP nWinnersSEXP, SEXP candidatesSEXP, SEXP seedSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< Rcpp::List >::type bs(bsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerMatrix >::type bs(bsSEXP);
+    Rcpp::traits::input_parameter< Rcpp::IntegerVector >::type counts(countsSEXP);
     Rcpp::traits::input_parameter< unsigned >::type nWinners(nWinnersSEXP);
     Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type candidates(candidatesSEXP);
     Rcpp::traits::input_parameter< std::string >::type seed(seedSEXP);
-    rcpp_result_gen = Rcpp::wrap(social_choice_irv(bs, nWinners, candidates, seed));
+    rcpp_result_gen = Rcpp::wrap(social_choice_irv(bs, counts, nWinners, candidates, seed));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -30,7 +31,7 @@ RcppExport SEXP run_testthat_tests(SEXP);
 RcppExport SEXP _rcpp_module_boot_dirichlet_tree_module();
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_elections_dtree_social_choice_irv", (DL_FUNC) &_elections_dtree_social_choice_irv, 4},
+    {"_elections_dtree_social_choice_irv", (DL_FUNC) &_elections_dtree_social_choice_irv, 5},
     {"_rcpp_module_boot_dirichlet_tree_module", (DL_FUNC) &_rcpp_module_boot_dirichlet_tree_module, 0},
     {"run_testthat_tests", (DL_FUNC) &run_testthat_tests, 1},
     {NULL, NULL, 0}
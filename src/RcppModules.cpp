@@ -25,10 +25,15 @@ RCPP_MODULE(dirichlet_tree_module) {
       .property("max_depth", &RDirichletTree::getMaxDepth,
                 &RDirichletTree::setMaxDepth)
       .property("vd", &RDirichletTree::getVD, &RDirichletTree::setVD)
+      .property("engine", &RDirichletTree::getEngine,
+                &RDirichletTree::setEngine)
       .property("candidates", &RDirichletTree::getCandidates)
+      .property("thread_stats", &RDirichletTree::getThreadStats)
       // Other methods
       .method("reset", &RDirichletTree::reset)
       .method("update", &RDirichletTree::update)
       .method("sample_predictive", &RDirichletTree::samplePredictive)
-      .method("sample_posterior", &RDirichletTree::samplePosterior);
+      .method("sample_posterior", &RDirichletTree::samplePosterior)
+      .method("sample_posterior_summary",
+              &RDirichletTree::samplePosteriorSummary);
 }
@@ -0,0 +1,38 @@
+/******************************************************************************
+ * File:             arena.cpp
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      This file implements the Arena methods as outlined in
+ *                   `arena.h`.
+ *****************************************************************************/
+
+#include "arena.h"
+
+Arena::~Arena() {
+  for (Slab &slab : slabs) delete[] slab.data;
+}
+
+void *Arena::allocate(size_t size, size_t align) {
+  nBytes += size;
+
+  // Find the first slab (starting from the current one) with enough space
+  // for the aligned allocation.
+  while (current < slabs.size()) {
+    size_t start = (offset + align - 1) / align * align;
+    if (start + size <= slabs[current].size) {
+      offset = start + size;
+      return slabs[current].data + start;
+    }
+    ++current;
+    offset = 0;
+  }
+
+  // Otherwise we need a new slab. Memory from `new[]` is suitably aligned for
+  // any fundamental type, so the allocation starts at offset zero.
+  size_t newSize = size > slabSize ? size : slabSize;
+  slabs.push_back({new char[newSize], newSize});
+  current = slabs.size() - 1;
+  offset = size;
+  return slabs[current].data;
+}
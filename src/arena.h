@@ -0,0 +1,91 @@
+/******************************************************************************
+ * File:             arena.h
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      This file declares a simple bump allocator used to store
+ *                   the interior nodes of a Dirichlet-tree. Memory is carved
+ *                   out of large slabs, and is released all at once by
+ *                   rewinding the arena rather than by freeing each node.
+ *****************************************************************************/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+class Arena {
+ private:
+  // A contiguous block of memory from which allocations are made.
+  struct Slab {
+    char *data;
+    size_t size;
+  };
+
+  // The default size of each slab in bytes.
+  size_t slabSize;
+
+  // All slabs owned by the arena. Slabs are retained when the arena is
+  // rewound so that they can be reused.
+  std::vector<Slab> slabs{};
+
+  // The index of the slab currently being allocated from.
+  size_t current = 0;
+
+  // The offset of the next free byte in the current slab.
+  size_t offset = 0;
+
+  // The number of bytes allocated since the arena was last rewound.
+  size_t nBytes = 0;
+
+ public:
+  /*! \brief Constructs an empty arena.
+   *
+   * \param slabSize_ The default size of each slab in bytes. Allocations
+   * larger than this are given a dedicated slab.
+   *
+   * \return An arena with no memory allocated.
+   */
+  Arena(size_t slabSize_ = 1 << 16) : slabSize(slabSize_) {}
+
+  // No copy constructor
+  Arena(const Arena &arena) = delete;
+
+  // Copy assignment via `=` operator is removed.
+  Arena &operator=(const Arena &) = delete;
+
+  ~Arena();
+
+  /*! \brief Allocates memory from the arena.
+   *
+   *  The returned memory is uninitialized, and remains valid until the arena
+   * is rewound or destroyed. Destructors of objects constructed in this memory
+   * are never called.
+   *
+   * \param size The number of bytes to allocate.
+   *
+   * \param align The required alignment of the allocation.
+   *
+   * \return A pointer to the allocated memory.
+   */
+  void *allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+  /*! \brief Releases every allocation made from the arena.
+   *
+   *  This is an O(1) operation. The slabs are kept, and subsequent allocations
+   * will reuse them.
+   */
+  void rewind() {
+    current = 0;
+    offset = 0;
+    nBytes = 0;
+  }
+
+  /*! \brief Gets the number of bytes allocated since the arena was last
+   * rewound, excluding any padding for alignment.
+   */
+  size_t getNBytes() const { return nBytes; }
+};
+
+#endif /* ARENA_H */
@@ -14,19 +14,39 @@
 #ifndef DIRICHLET_TREE_H
 #define DIRICHLET_TREE_H
 
+#include <algorithm>
+#include <iterator>
 #include <list>
-#include <map>
 #include <random>
+#include <vector>
 
+#include "arena.h"
 #include "irv_ballot.h"
+#include "outcome_table.h"
+#include "prng.h"
 #include "tree_node.h"
 
 template <typename NodeType, typename Outcome, class Parameters>
 class DirichletTree {
  private:
+  // The arena which owns every interior node of the Dirichlet-tree.
+  Arena arena{};
+
   // The interior root node for the Dirichlet-tree.
   NodeType *root;
 
+  // A flattened copy of the tree which is faster to sample from. It is built
+  // by `compile`, patched in place by `update` where possible, and otherwise
+  // invalidated until the next call to `compile`.
+  typename NodeType::Flat flat{};
+
+  // Whether `flat` is an up-to-date copy of the tree.
+  bool isCompiled = false;
+
+  // The default path for traversing the tree. Traversals permute it in place
+  // and restore it, so it is computed only once.
+  std::vector<unsigned> path;
+
   // The tree parameters. This object defines both the structure and sampling
   // parameters for the Dirichlet-tree. Some parameters will be immutable, for
   // example the tree structure cannot be changed dynamically while the prior
@@ -37,11 +57,12 @@ class DirichletTree {
 
   // The number of outcomes observed to obtain the posterior.
   unsigned nObserved = 0;
-  // A map of unique observations to the number of times it has been observed.
-  std::map<Outcome, unsigned> observed{};
+  // A table of unique observations and the number of times each has been
+  // observed.
+  OutcomeTable<Outcome> observed{};
 
   // A default PRNG for sampling.
-  std::mt19937 engine;
+  PRNG engine{};
 
  public:
   /*! \brief The DirichletTree constructor.
@@ -51,7 +72,7 @@ class DirichletTree {
    *
    * \param parameters_ The Dirichlet-tree parameters object.
    *
-   * \param seed A string representing the mt19937 initial seed.
+   * \param seed A string representing the PRNG initial seed.
    *
    * \return A DirichletTree object with the corresponding attributes.
    */
@@ -85,6 +106,44 @@ class DirichletTree {
    */
   void update(const std::pair<Outcome, unsigned> &oc);
 
+  /*! \brief Update a Dirichlet-tree with a batch of observed outcomes.
+   *
+   *  Equivalent to calling `update` with each pair, but identical outcomes
+   * are first aggregated and then sorted, so that outcomes sharing a path
+   * through the tree are traversed together.
+   *
+   * \param ocs A vector of (outcome, count) pairs. It is replaced with the
+   * aggregated and sorted outcomes.
+   *
+   * \return void
+   */
+  void update(std::vector<std::pair<Outcome, unsigned>> &ocs);
+
+  /*! \brief Flattens the tree into a contiguous representation for sampling.
+   *
+   *  Subsequent calls to `sample` and `posteriorSet` will use the flattened
+   * tree until it is invalidated by an update which adds new interior nodes,
+   * or by a reset. This does nothing if the flattened tree is up-to-date.
+   * This must not be called concurrently with sampling.
+   *
+   * \return void
+   */
+  void compile() {
+    if (isCompiled) return;
+    flat.build(root, parameters);
+    isCompiled = true;
+  }
+
+  /*! \brief Discards the flattened tree.
+   *
+   *  The flattened tree caches values derived from the parameters, so this
+   * must be called whenever the parameters change. The next call to `compile`
+   * rebuilds it.
+   *
+   * \return void
+   */
+  void invalidate() { isCompiled = false; }
+
   /*! \brief Sample outcomes from the posterior predictive distribution.
    *
    *  Samples a specified number of outcomes from one realisation of the
@@ -93,13 +152,31 @@ class DirichletTree {
    * \param n The number of outcomes to sample from a single realisation of the
    * Dirichlet-tree.
    *
-   * \param engine An optional warmed-up mt19937 PRNG for randomness.
+   * \param engine An optional warmed-up PRNG for randomness.
    *
    * \return A list of (outcome, count) pairs observed from the resulting
    * stochastic process.
    */
   std::list<std::pair<Outcome, unsigned>> sample(
-      unsigned n, std::mt19937 *engine = nullptr);
+      unsigned n, PRNG *engine = nullptr);
+
+  /*! \brief Sample outcomes from the posterior predictive distribution into a
+   * reusable buffer.
+   *
+   *  Samples a specified number of outcomes from one realisation of the
+   * Dirichlet-tree, appending the (outcome, count) pairs to `buffer`. Reusing
+   * the same buffer across draws avoids any heap allocation once it has grown
+   * to a sufficient size.
+   *
+   * \param n The number of outcomes to sample from a single realisation of the
+   * Dirichlet-tree.
+   *
+   * \param buffer The buffer to append sampled (outcome, count) pairs to.
+   *
+   * \param engine An optional warmed-up PRNG for randomness.
+   */
+  void sample(unsigned n, SampleBuffer<Outcome> &buffer,
+              PRNG *engine = nullptr);
 
   /*! \brief Sample possible full sets from the posterior.
    *
@@ -113,24 +190,43 @@ class DirichletTree {
    * \param N The number of observations in each complete set (must be >=
    * than the number of observed outcomes).
    *
-   * \param replacement A boolean indicating whether or not all draws should
+   * \param replace A boolean indicating whether or not all draws should
    * be re-sampled from the posterior predictive.
    *
-   * \return Returns one potential outcome sampled from the posterior
-   * Dirichlet-tree distribution, using the already observed data.
+   * \param buffer The buffer to store the potential outcome sampled from the
+   * posterior Dirichlet-tree distribution in. Any existing outcomes in the
+   * buffer are cleared first. If N is less than the number of observed
+   * outcomes, the buffer is left empty.
+   *
+   * \param engine An optional warmed-up PRNG for randomness.
    */
-  std::list<std::pair<Outcome, unsigned>> posteriorSet(
-      unsigned N, bool replace, std::mt19937 *engine = nullptr);
+  void posteriorSet(unsigned N, bool replace, SampleBuffer<Outcome> &buffer,
+                    PRNG *engine = nullptr);
 
   // Getters
 
   /*! \brief Get the PRNG engine.
    *
-   *  Gets a pointer to the mt19937 PRNG.
+   *  Gets a pointer to the PRNG.
+   *
+   * \return A pointer to the base engine.
+   */
+  PRNG *getEnginePtr() { return &engine; }
+
+  /*! \brief Gets the observed outcomes.
+   *
+   * \return A reference to the contiguous (outcome, count) pairs observed to
+   * obtain the posterior.
+   */
+  const std::vector<std::pair<Outcome, unsigned>> &getObserved() {
+    return observed.data();
+  }
+
+  /*! \brief Gets the number of observed outcomes.
    *
-   * \return A pointer to the base mt19937 engine.
+   * \return The total count of outcomes observed to obtain the posterior.
    */
-  std::mt19937 *getEnginePtr() { return &engine; }
+  unsigned getNObserved() { return nObserved; }
 
   /*! \brief Gets the tree parameters.
    *
@@ -140,9 +236,20 @@ class DirichletTree {
 
   // Setters
 
-  /*! \brief Sets the seed of the internal mt19937 PRNG.
+  /*! \brief Sets the engine of the internal PRNG.
    *
-   *  Resets the mt19937 seed and warms up the PRNG.
+   *  The PRNG is replaced with a default-seeded engine of the given kind, and
+   * should be reseeded with `setSeed` before sampling.
+   *
+   * \param kind The engine to use.
+   *
+   * \return void
+   */
+  void setEngine(PRNG::Kind kind) { engine = PRNG(PRNG::default_seed, kind); }
+
+  /*! \brief Sets the seed of the internal PRNG.
+   *
+   *  Resets the PRNG seed and warms up the PRNG.
    *
    * \param seed A string representing the new seed for the PRNG engine.
    *
@@ -160,20 +267,21 @@ template <typename NodeType, typename Outcome, typename Parameters>
 DirichletTree<NodeType, Outcome, Parameters>::DirichletTree(
     Parameters *parameters_, std::string seed) {
   parameters = parameters_;
+  path = parameters->defaultPath();
 
   // Initialize the root node of the tree.
-  root = new NodeType(0, parameters);
+  root = NodeType::create(0, parameters, &arena);
 
-  // Initialize a default PRNG, seed it and warm it up.
-  std::mt19937 engine{};
+  // Seed the default PRNG and warm it up.
   setSeed(seed);
 }
 
 template <typename NodeType, typename Outcome, typename Parameters>
 void DirichletTree<NodeType, Outcome, Parameters>::reset() {
-  // Replace the root node, calling the destructor of the old root after call.
-  delete root;
-  root = new NodeType(0, parameters);
+  // Release every node at once, then replace the root node.
+  arena.rewind();
+  root = NodeType::create(0, parameters, &arena);
+  isCompiled = false;
   // Destroy the observations list
   observed.clear();
   nObserved = 0;
@@ -182,56 +290,94 @@ void DirichletTree<NodeType, Outcome, Parameters>::reset() {
 template <typename NodeType, typename Outcome, typename Parameters>
 void DirichletTree<NodeType, Outcome, Parameters>::update(
     const std::pair<Outcome, unsigned> &oc) {
-  if (observed.count(oc.first) == 0) {
-    observed[oc.first] = oc.second;
-  } else {
-    observed[oc.first] = observed[oc.first] + oc.second;
-  }
+  observed.add(oc.first, oc.second);
   nObserved += oc.second;
-  std::vector<unsigned> path = parameters->defaultPath();
-  root->update(oc.first, path, oc.second);
+  root->update(oc.first, path, oc.second, &arena);
+  // Keep the flattened tree in sync, unless the tree structure has changed.
+  if (isCompiled) isCompiled = flat.update(oc.first, path, oc.second);
+}
+
+template <typename NodeType, typename Outcome, typename Parameters>
+void DirichletTree<NodeType, Outcome, Parameters>::update(
+    std::vector<std::pair<Outcome, unsigned>> &ocs) {
+  // Aggregate identical outcomes.
+  OutcomeTable<Outcome> counts{};
+  for (const auto &[o, count] : ocs) counts.add(o, count);
+  ocs = counts.release();
+  if (ocs.empty()) return;
+
+  // Sort them so outcomes sharing a path are adjacent.
+  std::sort(ocs.begin(), ocs.end(),
+            [](const std::pair<Outcome, unsigned> &a,
+               const std::pair<Outcome, unsigned> &b) {
+              return a.first < b.first;
+            });
+
+  for (const auto &oc : ocs) {
+    observed.add(oc.first, oc.second);
+    nObserved += oc.second;
+    // Keep the flattened tree in sync, unless the tree structure changes.
+    if (isCompiled) isCompiled = flat.update(oc.first, path, oc.second);
+  }
+  root->update(ocs.data(), ocs.data() + ocs.size(), path, &arena);
 }
 
 template <typename NodeType, typename Outcome, typename Parameters>
 std::list<std::pair<Outcome, unsigned>>
 DirichletTree<NodeType, Outcome, Parameters>::sample(unsigned n,
-                                                     std::mt19937 *engine_) {
+                                                     PRNG *engine_) {
+  SampleBuffer<Outcome> buffer;
+  sample(n, buffer, engine_);
+  return std::list<std::pair<Outcome, unsigned>>(
+      std::make_move_iterator(buffer.outcomes.begin()),
+      std::make_move_iterator(buffer.outcomes.end()));
+}
+
+template <typename NodeType, typename Outcome, typename Parameters>
+void DirichletTree<NodeType, Outcome, Parameters>::sample(
+    unsigned n, SampleBuffer<Outcome> &buffer, PRNG *engine_) {
   // Use the default engine unless one is passed to the method.
   if (engine_ == nullptr) {
     engine_ = &engine;
   }
 
-  // Initialize output
-  std::vector<unsigned> path = parameters->defaultPath();
-  std::list<std::pair<Outcome, unsigned>> out = root->sample(n, path, engine_);
-
-  return out;
+  // Each call gets its' own copy of the path, since sampling may occur
+  // concurrently. The copy reuses the buffer's storage.
+  buffer.path.assign(path.begin(), path.end());
+  // The tree has at most one level per element of the path, plus the leaves.
+  buffer.reserveDepths(path.size() + 1);
+  if (isCompiled) {
+    flat.sample(n, buffer.path, buffer, engine_);
+  } else {
+    root->sample(n, buffer.path, buffer, engine_);
+  }
 }
 
 template <typename NodeType, typename Outcome, typename Parameters>
 DirichletTree<NodeType, Outcome, Parameters>::~DirichletTree() {
-  delete root;
+  // The nodes are released along with the arena.
 }
 
 template <typename NodeType, typename Outcome, typename Parameters>
-std::list<std::pair<Outcome, unsigned>>
-DirichletTree<NodeType, Outcome, Parameters>::posteriorSet(
-    unsigned N, bool replace, std::mt19937 *engine) {
+void DirichletTree<NodeType, Outcome, Parameters>::posteriorSet(
+    unsigned N, bool replace, SampleBuffer<Outcome> &buffer,
+    PRNG *engine) {
+  buffer.clear();
+
   // Handle the sampling with replacement case first.
   if (replace) {
-    return sample(N, engine);
+    sample(N, buffer, engine);
+    return;
   }
 
-  // Handle invalid case by returning empty list.
-  if (nObserved > N) return {};
-
-  // Initialize output by copying observed data.
-  std::list<std::pair<Outcome, unsigned>> out(observed.begin(), observed.end());
+  // Handle invalid case by returning an empty buffer.
+  if (nObserved > N) return;
 
-  // Then sample new outcomes and add them to the end of the list.
-  out.splice(out.end(), sample(N - nObserved, engine));
+  // Initialize output by copying the contiguous observed data.
+  buffer.outcomes.assign(observed.begin(), observed.end());
 
-  return out;
+  // Then sample new outcomes and add them to the end of the buffer.
+  sample(N - nObserved, buffer, engine);
 }
 
 #endif /* DIRICHLET_TREE_H */
@@ -9,20 +9,268 @@
 
 #include "distributions.h"
 
+namespace {
+
+// The ziggurat tables for the standard normal distribution with 128 layers.
+// kn holds the acceptance thresholds for the 31-bit magnitude, wn the scale
+// of each layer and fn the density at each layer boundary.
+struct ZigguratTables {
+  uint32_t kn[128];
+  double wn[128];
+  double fn[128];
+
+  ZigguratTables() {
+    const double m1 = 2147483648.0;
+    const double vn = 9.91256303526217e-3;
+    double dn = 3.442619855899, tn = dn;
+    double q = vn / std::exp(-0.5 * dn * dn);
+
+    kn[0] = static_cast<uint32_t>((dn / q) * m1);
+    kn[1] = 0;
+    wn[0] = q / m1;
+    wn[127] = dn / m1;
+    fn[0] = 1.;
+    fn[127] = std::exp(-0.5 * dn * dn);
+
+    for (int i = 126; i >= 1; --i) {
+      dn = std::sqrt(-2. * std::log(vn / dn + std::exp(-0.5 * dn * dn)));
+      kn[i + 1] = static_cast<uint32_t>((dn / tn) * m1);
+      tn = dn;
+      fn[i] = std::exp(-0.5 * dn * dn);
+      wn[i] = dn / m1;
+    }
+  }
+};
+
+const ZigguratTables zig{};
+
+// The start of the tail of the ziggurat.
+constexpr double zigR = 3.442619855899;
+
+}  // namespace
+
+double rNormal(PRNG *engine) {
+  for (;;) {
+    int32_t hz = static_cast<int32_t>((*engine)());
+    uint32_t iz = hz & 127;
+    uint32_t mag = hz < 0 ? 0u - static_cast<uint32_t>(hz) : hz;
+    // The fast path: the point lies within the rectangular part of a layer.
+    if (mag < zig.kn[iz]) return hz * zig.wn[iz];
+
+    double x = hz * zig.wn[iz];
+    if (iz == 0) {
+      // Sample from the tail beyond zigR.
+      double y;
+      do {
+        x = -std::log(rUniform(engine)) / zigR;
+        y = -std::log(rUniform(engine));
+      } while (y + y < x * x);
+      return hz > 0 ? zigR + x : -zigR - x;
+    }
+    // Otherwise accept within the wedge according to the density.
+    if (zig.fn[iz] + rUniform(engine) * (zig.fn[iz - 1] - zig.fn[iz]) <
+        std::exp(-0.5 * x * x))
+      return x;
+  }
+}
+
+// Samples Binomial(n, p) for p <= 0.5 by sequential search from zero. The
+// expected number of iterations is n * p + 1.
+static unsigned binomialInversion(unsigned n, double p, PRNG *engine) {
+  double q = 1. - p;
+  double s = p / q;
+  double a = (n + 1) * s;
+  double r0 = std::pow(q, n);
+  // The search is restarted far out in the tail, which guards against
+  // rounding in the recurrence.
+  double np = n * p;
+  double bound = std::min(static_cast<double>(n),
+                          np + 10. * std::sqrt(np * q + 1.));
+  for (;;) {
+    double r = r0;
+    double u = rUniform(engine);
+    unsigned x = 0;
+    while (u > r) {
+      u -= r;
+      ++x;
+      if (x > bound) break;
+      r *= a / x - s;
+    }
+    if (x <= bound) return x;
+  }
+}
+
+// The Stirling series correction for log(k!), used by the final BTPE test.
+static double stirlingTail(double k) {
+  double k2 = k * k;
+  return (13680. - (462. - (132. - (99. - 140. / k2) / k2) / k2) / k2) / k /
+         166320.;
+}
+
+// Samples Binomial(n, p) for p <= 0.5 with the BTPE algorithm. The
+// proposal is a triangle over the mode, flanked by parallelograms and
+// exponential tails, with squeezes to avoid evaluating the density.
+static unsigned binomialBTPE(unsigned n, double p, PRNG *engine) {
+  double q = 1. - p;
+  double nrq = n * p * q;
+  double fm = n * p + p;
+  double m = std::floor(fm);
+  double p1 = std::floor(2.195 * std::sqrt(nrq) - 4.6 * q) + 0.5;
+  double xm = m + 0.5;
+  double xl = xm - p1;
+  double xr = xm + p1;
+  double c = 0.134 + 20.5 / (15.3 + m);
+  double a = (fm - xl) / (fm - xl * p);
+  double laml = a * (1. + a / 2.);
+  a = (xr - fm) / (xr * q);
+  double lamr = a * (1. + a / 2.);
+  double p2 = p1 * (1. + 2. * c);
+  double p3 = p2 + c / laml;
+  double p4 = p3 + c / lamr;
+
+  for (;;) {
+    double u = rUniform(engine) * p4;
+    double v = rUniform(engine);
+    double y;
+
+    if (u <= p1) {
+      // The triangular region is accepted immediately.
+      return static_cast<unsigned>(std::floor(xm - p1 * v + u));
+    } else if (u <= p2) {
+      // The parallelograms.
+      double x = xl + (u - p1) / c;
+      v = v * c + 1. - std::fabs(m - x + 0.5) / p1;
+      if (v > 1.) continue;
+      y = std::floor(x);
+    } else if (u <= p3) {
+      // The left exponential tail.
+      y = std::floor(xl + std::log(v) / laml);
+      if (y < 0.) continue;
+      v = v * (u - p2) * laml;
+    } else {
+      // The right exponential tail.
+      y = std::floor(xr - std::log(v) / lamr);
+      if (y > n) continue;
+      v = v * (u - p3) * lamr;
+    }
+
+    double k = std::fabs(y - m);
+    if (k <= 20. || k >= nrq / 2. - 1.) {
+      // Evaluate the density ratio f(y) / f(m) by recurrence.
+      double s = p / q;
+      double aa = s * (n + 1);
+      double f = 1.;
+      if (m < y) {
+        for (double i = m + 1; i <= y; ++i) f *= aa / i - s;
+      } else if (m > y) {
+        for (double i = y + 1; i <= m; ++i) f /= aa / i - s;
+      }
+      if (v <= f) return static_cast<unsigned>(y);
+      continue;
+    }
+
+    // Squeeze using upper and lower bounds on log(f(y) / f(m)).
+    double rho =
+        (k / nrq) * ((k * (k / 3. + 0.625) + 0.1666666666666) / nrq + 0.5);
+    double t = -k * k / (2. * nrq);
+    double logV = std::log(v);
+    if (logV < t - rho) return static_cast<unsigned>(y);
+    if (logV > t + rho) continue;
+
+    // The final acceptance test, using Stirling's formula.
+    double x1 = y + 1.;
+    double f1 = m + 1.;
+    double z = n + 1. - m;
+    double w = n - y + 1.;
+    if (logV <= xm * std::log(f1 / x1) + (n - m + 0.5) * std::log(z / w) +
+                    (y - m) * std::log(w * p / (x1 * q)) + stirlingTail(f1) +
+                    stirlingTail(z) + stirlingTail(x1) + stirlingTail(w))
+      return static_cast<unsigned>(y);
+  }
+}
+
+unsigned rBinomial(unsigned n, double p, PRNG *engine) {
+  if (n == 0 || p <= 0.) return 0;
+  if (p >= 1.) return n;
+  // Both methods require p <= 0.5, so sample failures otherwise.
+  if (p > 0.5) return n - rBinomial(n, 1. - p, engine);
+  if (n * p < 30.) return binomialInversion(n, p, engine);
+  return binomialBTPE(n, p, engine);
+}
+
+// Normalizes gamma variates into Dirichlet probabilities.
+static void normalizeGammas(std::vector<double> &gamma, double gamma_sum,
+                            PRNG *engine) {
+  size_t d = gamma.size();
+
+  // Edge case where all gammas are zero.
+  if (gamma_sum == 0.) {
+    // Choose index i uniformly at random to have p_i=1, and set all others to
+    // p_j=0.
+    std::uniform_int_distribution<unsigned> rint(0, d - 1);
+    unsigned idx = rint(*engine);
+    for (size_t i = 0; i < d; ++i) gamma[i] = 0.;
+    gamma[idx] = 1.;
+    return;
+  }
+
+  // Otherwise normalize the gamma variates.
+  double inv_sum = 1. / gamma_sum;
+  for (size_t i = 0; i < d; ++i) gamma[i] *= inv_sum;
+}
+
 std::vector<unsigned> rDirichletMultinomial(const unsigned &N,
                                             const std::vector<double> &a,
-                                            std::mt19937 *engine) {
+                                            PRNG *engine) {
+  std::vector<double> p;
+  std::vector<unsigned> out;
+  rDirichletMultinomial(N, a, p, out, engine);
+  return out;
+}
+
+void rDirichletMultinomial(const unsigned &N, const std::vector<double> &a,
+                           std::vector<double> &p, std::vector<unsigned> &out,
+                           PRNG *engine) {
   // Draw p ~ Dirichlet(a)
-  std::vector<double> p = rDirichlet(a, engine);
+  rDirichlet(a, p, engine);
   // Draw out ~ Multinomial(p)
-  return rMultinomial(N, p, engine);
+  rMultinomial(N, p, out, engine);
+}
+
+void rDirichletMultinomial(const unsigned &N, const GammaSampler *gammas,
+                           size_t d, std::vector<double> &p,
+                           std::vector<unsigned> &out, PRNG *engine) {
+  rDirichlet(gammas, d, p, engine);
+  rMultinomial(N, p, out, engine);
+}
+
+void rDirichletMultinomial(const unsigned &N, const GammaSampler &gamma,
+                           size_t d, std::vector<double> &p,
+                           std::vector<unsigned> &out, PRNG *engine) {
+  rDirichlet(gamma, d, p, engine);
+  rMultinomial(N, p, out, engine);
+}
+
+void rDirichletMultinomial(const unsigned &N, const GammaSampler &gamma,
+                           const GammaSampler *gammas, const unsigned *indices,
+                           size_t n, size_t d, std::vector<double> &p,
+                           std::vector<unsigned> &out, PRNG *engine) {
+  rDirichlet(gamma, gammas, indices, n, d, p, engine);
+  rMultinomial(N, p, out, engine);
 }
 
 std::vector<unsigned> rMultinomial(const unsigned &N,
                                    const std::vector<double> &p,
-                                   std::mt19937 *engine) {
+                                   PRNG *engine) {
+  std::vector<unsigned> out;
+  rMultinomial(N, p, out, engine);
+  return out;
+}
+
+void rMultinomial(const unsigned &N, const std::vector<double> &p,
+                  std::vector<unsigned> &out, PRNG *engine) {
   size_t d = p.size();
-  std::vector<unsigned> out(p.size());
+  out.resize(d);
 
   // norm is necessary because floating point precision does not often allow
   // the probabilities p to sum to exactly 1.0f.
@@ -34,51 +282,80 @@ std::vector<unsigned> rMultinomial(const unsigned &N,
   double pnorm;
   unsigned n = N;
   for (size_t i = 0; i < d; ++i) {
-    if (norm - (sum_ps + p[i]) == 0.0) {
-      // First check if this is the last positive p.
+    if (n == 0 || norm - (sum_ps + p[i]) == 0.0) {
+      // First check if this is the last positive p, or whether every sample
+      // has already been allocated.
       out[i] = n;
       for (size_t j = i + 1; j < d; ++j) out[j] = 0;
       break;
     } else {
       // Otherwise continue to draw using binomial marginals
       pnorm = p[i] / (norm - sum_ps);
-      std::binomial_distribution<unsigned> b(n, pnorm);
-      out[i] = b(*engine);
+      out[i] = rBinomial(n, pnorm, engine);
       n -= out[i];
       // Normalise remaining ps.
       sum_ps += p[i];
     }
   }
-  return out;
 }
 
 std::vector<double> rDirichlet(const std::vector<double> &a,
-                               std::mt19937 *engine) {
-  unsigned d = a.size();
-  std::vector<double> gamma(d);
+                               PRNG *engine) {
+  std::vector<double> gamma;
+  rDirichlet(a, gamma, engine);
+  return gamma;
+}
+
+void rDirichlet(const std::vector<double> &a, std::vector<double> &gamma,
+                PRNG *engine) {
+  size_t d = a.size();
+  gamma.resize(d);
   double gamma_sum = 0.;
 
   // Sample the gamma variates for category i.
   for (size_t i = 0; i < d; ++i) {
-    std::gamma_distribution<double> g(a[i]);
-    gamma[i] = g(*engine);
+    gamma[i] = rGamma(a[i], engine);
     gamma_sum += gamma[i];
   }
 
-  // Edge case where all gammas are zero.
-  if (gamma_sum == 0.) {
-    // Choose index i uniformly at random to have p_i=1, and set all others to
-    // p_j=0.
-    std::uniform_int_distribution<unsigned> rint(0, d - 1);
-    unsigned idx = rint(*engine);
-    for (size_t i = 0; i < d; ++i) gamma[i] = 0.;
-    gamma[idx] = 1.;
-    return gamma;
+  normalizeGammas(gamma, gamma_sum, engine);
+}
+
+void rDirichlet(const GammaSampler *gammas, size_t d,
+                std::vector<double> &gamma, PRNG *engine) {
+  gamma.resize(d);
+  double gamma_sum = 0.;
+  for (size_t i = 0; i < d; ++i) {
+    gamma[i] = gammas[i](engine);
+    gamma_sum += gamma[i];
+  }
+  normalizeGammas(gamma, gamma_sum, engine);
+}
+
+void rDirichlet(const GammaSampler &g, size_t d, std::vector<double> &gamma,
+                PRNG *engine) {
+  gamma.resize(d);
+  double gamma_sum = 0.;
+  for (size_t i = 0; i < d; ++i) {
+    gamma[i] = g(engine);
+    gamma_sum += gamma[i];
   }
+  normalizeGammas(gamma, gamma_sum, engine);
+}
 
-  // Otherwise normalize the gamma variates and return.
+void rDirichlet(const GammaSampler &g, const GammaSampler *gammas,
+                const unsigned *indices, size_t n, size_t d,
+                std::vector<double> &gamma, PRNG *engine) {
+  gamma.resize(d);
+  double gamma_sum = 0.;
+  size_t k = 0;
   for (size_t i = 0; i < d; ++i) {
-    gamma[i] = gamma[i] / gamma_sum;
+    if (k < n && indices[k] == i) {
+      gamma[i] = gammas[k++](engine);
+    } else {
+      gamma[i] = g(engine);
+    }
+    gamma_sum += gamma[i];
   }
-  return gamma;
+  normalizeGammas(gamma, gamma_sum, engine);
 }
@@ -11,9 +11,129 @@
 #define DISTRIBUTIONS_H
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <random>
 #include <vector>
 
+#include "prng.h"
+
+/*! \brief Draws a standard normal variate.
+ *
+ *  Uses the ziggurat method of Marsaglia and Tsang (2000), which needs a
+ * single 32-bit draw from the PRNG in the vast majority of cases.
+ *
+ * \param engine A PRNG for sampling.
+ *
+ * \return A sample from the standard normal distribution.
+ */
+double rNormal(PRNG *engine);
+
+/*! \brief Draws a uniform variate on the open interval (0, 1).
+ *
+ * \param engine A PRNG for sampling.
+ *
+ * \return A sample from the Uniform(0, 1) distribution, never 0 or 1.
+ */
+inline double rUniform(PRNG *engine) {
+  return ((*engine)() + 0.5) * 0x1p-32;
+}
+
+/*! \brief Draws a sample from a Binomial distribution.
+ *
+ *  Uses inversion when the mean is small, and otherwise the BTPE algorithm of
+ * Kachitvichyanukul and Schmeiser (1988), whose expected cost does not grow
+ * with the number of trials.
+ *
+ * \param n The number of trials.
+ *
+ * \param p The success probability of each trial.
+ *
+ * \param engine A PRNG for sampling.
+ *
+ * \return The number of successes.
+ */
+unsigned rBinomial(unsigned n, double p, PRNG *engine);
+
+/*! \brief A gamma(a, 1) sampler with precomputed constants.
+ *
+ *  Samples using the method of Marsaglia and Tsang (2000). For a < 1, a
+ * gamma(a + 1) variate is drawn and scaled by U^(1/a). The constants depend
+ * only on `a`, so a sampler should be constructed once and reused whenever
+ * the same parameter is sampled repeatedly. A parameter a <= 0 gives the
+ * degenerate distribution at zero.
+ */
+class GammaSampler {
+ private:
+  // The shape parameter.
+  double a = 0.;
+  // The Marsaglia-Tsang constants d = a' - 1/3 and c = 1/sqrt(9d), where a'
+  // is a, or a + 1 if a < 1.
+  double d = 0.;
+  double c = 0.;
+  // 1/a, for the a < 1 boost. Zero if no boost is required.
+  double invA = 0.;
+
+ public:
+  /*! \brief Constructs a gamma sampler.
+   *
+   * \param a_ The shape parameter of the gamma distribution.
+   */
+  GammaSampler(double a_ = 0.) : a(a_) {
+    if (a <= 0.) return;
+    double aBoosted = a;
+    if (a < 1.) {
+      aBoosted = a + 1.;
+      invA = 1. / a;
+    }
+    d = aBoosted - 1. / 3.;
+    c = 1. / std::sqrt(9. * d);
+  }
+
+  /*! \brief Gets the shape parameter.
+   *
+   * \return The shape parameter of the gamma distribution.
+   */
+  double getA() const { return a; }
+
+  /*! \brief Draws a gamma(a, 1) variate.
+   *
+   * \param engine A PRNG for sampling.
+   *
+   * \return A sample from the gamma(a, 1) distribution.
+   */
+  double operator()(PRNG *engine) const {
+    if (a <= 0.) return 0.;
+    double x, v, u;
+    for (;;) {
+      do {
+        x = rNormal(engine);
+        v = 1. + c * x;
+      } while (v <= 0.);
+      v = v * v * v;
+      u = rUniform(engine);
+      // The squeeze accepts about 98% of proposals without a logarithm.
+      double x2 = x * x;
+      if (u < 1. - 0.0331 * x2 * x2) break;
+      if (std::log(u) < 0.5 * x2 + d * (1. - v + std::log(v))) break;
+    }
+    if (invA == 0.) return d * v;
+    return d * v * std::pow(rUniform(engine), invA);
+  }
+};
+
+/*! \brief Draws a sample from a gamma(a, 1) distribution.
+ *
+ * \param a The shape parameter.
+ *
+ * \param engine A PRNG for sampling.
+ *
+ * \return A sample from the gamma(a, 1) distribution.
+ */
+inline double rGamma(double a, PRNG *engine) {
+  return GammaSampler(a)(engine);
+}
+
 /*! \brief Draws a sample from a Dirichlet Multinomial distribution.
  *
  *  Given the count, `a` parameters and dimension of the distribution, this
@@ -30,7 +150,93 @@
  */
 std::vector<unsigned> rDirichletMultinomial(const unsigned &N,
                                             const std::vector<double> &a,
-                                            std::mt19937 *engine);
+                                            PRNG *engine);
+
+/*! \brief Draws a sample from a Dirichlet Multinomial distribution into
+ * caller-provided buffers.
+ *
+ *  Equivalent to `rDirichletMultinomial(N, a, engine)`, but writes the sampled
+ * counts into `out` and uses `p` as scratch space for the Dirichlet draw.
+ * Neither buffer is reallocated once it has sufficient capacity.
+ *
+ * \param N The total number of multinomial samples.
+ *
+ * \param a The `a` parameter to the Dirichlet distribution.
+ *
+ * \param p Scratch space for the sampled Dirichlet probabilities.
+ *
+ * \param out The vector to store the sampled counts in.
+ *
+ * \param engine A PRNG for sampling.
+ */
+void rDirichletMultinomial(const unsigned &N, const std::vector<double> &a,
+                           std::vector<double> &p, std::vector<unsigned> &out,
+                           PRNG *engine);
+
+/*! \brief Draws a sample from a Dirichlet Multinomial distribution, given a
+ * precomputed gamma sampler for each Dirichlet parameter.
+ *
+ * \param N The total number of multinomial samples.
+ *
+ * \param gammas The gamma sampler for each of the `d` Dirichlet parameters.
+ *
+ * \param d The dimension of the distribution.
+ *
+ * \param p Scratch space for the sampled Dirichlet probabilities.
+ *
+ * \param out The vector to store the sampled counts in.
+ *
+ * \param engine A PRNG for sampling.
+ */
+void rDirichletMultinomial(const unsigned &N, const GammaSampler *gammas,
+                           size_t d, std::vector<double> &p,
+                           std::vector<unsigned> &out, PRNG *engine);
+
+/*! \brief Draws a sample from a symmetric Dirichlet Multinomial
+ * distribution, given a precomputed gamma sampler shared by every parameter.
+ *
+ * \param N The total number of multinomial samples.
+ *
+ * \param gamma The gamma sampler for the common Dirichlet parameter.
+ *
+ * \param d The dimension of the distribution.
+ *
+ * \param p Scratch space for the sampled Dirichlet probabilities.
+ *
+ * \param out The vector to store the sampled counts in.
+ *
+ * \param engine A PRNG for sampling.
+ */
+void rDirichletMultinomial(const unsigned &N, const GammaSampler &gamma,
+                           size_t d, std::vector<double> &p,
+                           std::vector<unsigned> &out, PRNG *engine);
+
+/*! \brief Draws a sample from a Dirichlet Multinomial distribution whose
+ * Dirichlet parameters are shared, except for a few.
+ *
+ * \param N The total number of multinomial samples.
+ *
+ * \param gamma The gamma sampler for the shared Dirichlet parameter.
+ *
+ * \param gammas The gamma sampler for each parameter which is not shared.
+ *
+ * \param indices The index of each parameter which is not shared, in
+ * ascending order. Indices of `d` or more are ignored.
+ *
+ * \param n The number of parameters which are not shared.
+ *
+ * \param d The dimension of the distribution.
+ *
+ * \param p Scratch space for the sampled Dirichlet probabilities.
+ *
+ * \param out The vector to store the sampled counts in.
+ *
+ * \param engine A PRNG for sampling.
+ */
+void rDirichletMultinomial(const unsigned &N, const GammaSampler &gamma,
+                           const GammaSampler *gammas, const unsigned *indices,
+                           size_t n, size_t d, std::vector<double> &p,
+                           std::vector<unsigned> &out, PRNG *engine);
 
 /*! \brief Draws a sample from a Multinomial distribution.
  *
@@ -48,7 +254,20 @@ std::vector<unsigned> rDirichletMultinomial(const unsigned &N,
  */
 std::vector<unsigned> rMultinomial(const unsigned &N,
                                    const std::vector<double> &p,
-                                   std::mt19937 *engine);
+                                   PRNG *engine);
+
+/*! \brief Draws a sample from a Multinomial distribution into `out`.
+ *
+ * \param N The total number of Multinomial samples.
+ *
+ * \param p A vector of category probabilities.
+ *
+ * \param out The vector to store the sampled counts in.
+ *
+ * \param engine A PRNG for sampling.
+ */
+void rMultinomial(const unsigned &N, const std::vector<double> &p,
+                  std::vector<unsigned> &out, PRNG *engine);
 
 /*! \brief Draws a sample from a Dirichlet distribution.
  *
@@ -64,6 +283,70 @@ std::vector<unsigned> rMultinomial(const unsigned &N,
  * \return A single sample from a Dirichlet(a) random variable.
  */
 std::vector<double> rDirichlet(const std::vector<double> &a,
-                               std::mt19937 *engine);
+                               PRNG *engine);
+
+/*! \brief Draws a sample from a Dirichlet distribution into `out`.
+ *
+ * \param a The a parameter to the Dirichlet distribution
+ *
+ * \param out The vector to store the sampled probabilities in.
+ *
+ * \param *engine A PRNG for sampling.
+ */
+void rDirichlet(const std::vector<double> &a, std::vector<double> &out,
+                PRNG *engine);
+
+/*! \brief Draws a sample from a Dirichlet distribution into `out`, given a
+ * precomputed gamma sampler for each parameter.
+ *
+ * \param gammas The gamma sampler for each of the `d` Dirichlet parameters.
+ *
+ * \param d The dimension of the distribution.
+ *
+ * \param out The vector to store the sampled probabilities in.
+ *
+ * \param engine A PRNG for sampling.
+ */
+void rDirichlet(const GammaSampler *gammas, size_t d, std::vector<double> &out,
+                PRNG *engine);
+
+/*! \brief Draws a sample from a symmetric Dirichlet distribution into `out`,
+ * given a precomputed gamma sampler shared by every parameter.
+ *
+ * \param gamma The gamma sampler for the common Dirichlet parameter.
+ *
+ * \param d The dimension of the distribution.
+ *
+ * \param out The vector to store the sampled probabilities in.
+ *
+ * \param engine A PRNG for sampling.
+ */
+void rDirichlet(const GammaSampler &gamma, size_t d, std::vector<double> &out,
+                PRNG *engine);
+
+/*! \brief Draws a sample from a Dirichlet distribution into `out`, whose
+ * parameters are shared, except for a few.
+ *
+ *  Equivalent to `rDirichlet(gammas, d, out, engine)` with the full array of
+ * gamma samplers, consuming the PRNG in the same order.
+ *
+ * \param gamma The gamma sampler for the shared parameter.
+ *
+ * \param gammas The gamma sampler for each parameter which is not shared.
+ *
+ * \param indices The index of each parameter which is not shared, in
+ * ascending order. Indices of `d` or more are ignored.
+ *
+ * \param n The number of parameters which are not shared.
+ *
+ * \param d The dimension of the distribution.
+ *
+ * \param out The vector to store the sampled probabilities in.
+ *
+ * \param engine A PRNG for sampling.
+ */
+void rDirichlet(const GammaSampler &gamma, const GammaSampler *gammas,
+                const unsigned *indices, size_t n, size_t d,
+                std::vector<double> &out, PRNG *engine);
 
 #endif /* DISTRIBUTIONS_H */
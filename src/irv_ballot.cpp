@@ -9,12 +9,67 @@
 
 #include "irv_ballot.h"
 
-IRVBallot::IRVBallot(std::list<unsigned> preferences_) {
-  preferences = std::move(preferences_);
+#include "irv_tabulator.h"
+
+void IRVBallot::allocate(unsigned n_, unsigned maxIndex) {
+  release();
+  n = n_;
+  isPacked = n <= nInline && maxIndex <= std::numeric_limits<uint8_t>::max();
+  if (!isPacked) wide = new unsigned[n];
+}
+
+IRVBallot::IRVBallot(const IRVBallot &b) { *this = b; }
+
+IRVBallot::IRVBallot(IRVBallot &&b) noexcept { *this = std::move(b); }
+
+IRVBallot &IRVBallot::operator=(const IRVBallot &b) {
+  if (this == &b) return *this;
+  release();
+  n = b.n;
+  isPacked = b.isPacked;
+  if (isPacked) {
+    std::memcpy(packed, b.packed, n);
+  } else {
+    wide = new unsigned[n];
+    std::copy(b.wide, b.wide + n, wide);
+  }
+  return *this;
+}
+
+IRVBallot &IRVBallot::operator=(IRVBallot &&b) noexcept {
+  if (this == &b) return *this;
+  release();
+  n = b.n;
+  isPacked = b.isPacked;
+  if (isPacked) {
+    std::memcpy(packed, b.packed, n);
+  } else {
+    // Steal the heap array, leaving b as an empty packed ballot.
+    wide = b.wide;
+    b.isPacked = true;
+    b.n = 0;
+  }
+  return *this;
 }
 
 bool IRVBallot::eliminateFirstPref() {
-  preferences.pop_front();
+  --n;
+  if (isPacked) {
+    std::memmove(packed, packed + 1, n);
+  } else {
+    std::copy(wide + 1, wide + n + 1, wide);
+    // Repack the preferences once they fit inline, so that equal ballots
+    // always share a representation.
+    if (n <= nInline &&
+        std::all_of(wide, wide + n, [](unsigned c) {
+          return c <= std::numeric_limits<uint8_t>::max();
+        })) {
+      unsigned *w = wide;
+      isPacked = true;
+      for (unsigned i = 0; i < n; ++i) packed[i] = static_cast<uint8_t>(w[i]);
+      delete[] w;
+    }
+  }
   // Return whether or not the ballot is empty.
   if (nPreferences() == 0) {
     return true;
@@ -23,116 +78,82 @@ bool IRVBallot::eliminateFirstPref() {
   }
 }
 
-bool IRVBallot::operator==(const IRVBallot &b) {
+size_t IRVBallot::hash() const {
+  // A 64-bit multiply-xorshift mix, seeded with the number of preferences.
+  uint64_t h = 0x9E3779B97F4A7C15ULL ^ n;
+  auto mix = [&h](uint64_t word) {
+    h ^= word;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 31;
+  };
+  if (isPacked) {
+    // Only the first n bytes are defined, so the final word is zero-padded.
+    for (unsigned i = 0; i < n; i += sizeof(uint64_t)) {
+      uint64_t word = 0;
+      std::memcpy(&word, packed + i,
+                  std::min<unsigned>(sizeof(uint64_t), n - i));
+      mix(word);
+    }
+  } else {
+    for (unsigned i = 0; i < n; ++i) mix(wide[i]);
+  }
+  return static_cast<size_t>(h);
+}
+
+bool IRVBallot::operator==(const IRVBallot &b) const {
   // First check the number of specified candidates is equal.
   if (!(nPreferences() == b.nPreferences())) {
     return false;
   }
   // Then check each preference to ensure they are equal.
-  return std::equal(preferences.begin(), preferences.end(),
-                    b.preferences.begin());
+  if (isPacked && b.isPacked) return std::memcmp(packed, b.packed, n) == 0;
+  for (unsigned i = 0; i < n; ++i) {
+    if ((*this)[i] != b[i]) return false;
+  }
+  return true;
 }
 
 bool IRVBallot::operator<(const IRVBallot &b) const {
-  return std::lexicographical_compare(preferences.begin(), preferences.end(),
-                                      b.preferences.begin(),
-                                      b.preferences.end());
+  unsigned nCommon = std::min(n, b.n);
+  for (unsigned i = 0; i < nCommon; ++i) {
+    if ((*this)[i] != b[i]) return (*this)[i] < b[i];
+  }
+  return n < b.n;
 }
 
-std::vector<unsigned> socialChoiceIRV(std::list<IRVBallotCount> &ballots,
-                                      unsigned nCandidates,
-                                      std::mt19937 *engine) {
-  unsigned firstPref;
-  bool isEmpty = false;
-
-  // For tie-breaking
-  std::uniform_int_distribution<> rand_int_distr;
-
-  std::vector<unsigned> out{};
-
-  // Filter out the empty ballots, as these are useless to the
-  // social choice function.
-  ballots.remove_if(
-      [](IRVBallotCount &b) { return b.first.nPreferences() == 0; });
-
-  unsigned nEliminations = 0;
-
-  // An array of booleans representing whether or not the candidate index has
-  // been eliminated.
-  std::vector<bool> eliminated(nCandidates, false);
-
-  // The minimum tally among standing candidates.
-  unsigned min_tally;
-  std::vector<unsigned> tied_min{};
-
-  // The index of the next candidate to be eliminated.
-  unsigned elim;
-
-  // Vector of lists of iterators to the ballotcounts which contribute to the
-  // tally for each candidate.
-  std::vector<std::list<std::list<IRVBallotCount>::iterator>> tally_groups(
-      nCandidates);
-  // The vector of candidate tallies.
-  std::vector<unsigned> tallies(nCandidates, 0);
-
-  // Tally the initial first preferences for each ballot.
-  for (auto it = ballots.begin(); it != ballots.end(); ++it) {
-    firstPref = it->first.firstPreference();
-    tally_groups[firstPref].push_back(it);
-    tallies[firstPref] += it->second;
+IRVBallotGroups::IRVBallotGroups(
+    const std::vector<IRVBallotCount> &ballotcounts, unsigned nCandidates) {
+  offsets.assign(nCandidates + 1, 0);
+  tallies.assign(nCandidates, 0);
+
+  // Count the ballots with each first preference, then place them with a
+  // counting sort.
+  for (const auto &[b, count] : ballotcounts) {
+    if (b.nPreferences() == 0) continue;
+    ++offsets[b.firstPreference() + 1];
+    tallies[b.firstPreference()] += count;
   }
+  for (unsigned c = 0; c < nCandidates; ++c) offsets[c + 1] += offsets[c];
 
-  // While more than one candidate stands.
-  while (nEliminations < nCandidates) {
-    // Determine candidates with the minimum tally.
-    min_tally = std::numeric_limits<unsigned>::max();
-    for (unsigned i = 0; i < nCandidates; ++i) {
-      if (!eliminated[i] && tallies[i] <= min_tally) {
-        if (tallies[i] == min_tally) {
-          tied_min.push_back(i);
-        } else {
-          tied_min = {i};
-          min_tally = tallies[i];
-        }
-      }
-    }
-    // Tie-break by choosing at random from the tied candidates.
-    rand_int_distr = std::uniform_int_distribution<>(
-        0, std::distance(tied_min.begin(), tied_min.end()) - 1);
-    elim = tied_min[rand_int_distr(*engine)];
-
-    // Eliminate the standing candidate with the minimum tally.
-    eliminated[elim] = true;
-    out.push_back(elim);
-
-    // Redistribute the ballots attributed to the losing candidate.
-    auto list_start = tally_groups[elim].begin();
-    auto list_end = tally_groups[elim].end();
-    while (list_start != list_end) {
-      // Delete all eliminated candidates from the start of the ballot.
-      firstPref = (*list_start)->first.firstPreference();
-      while (eliminated[firstPref]) {
-        // Check if the ballot was emptied. If so, we break now.
-        isEmpty = (*list_start)->first.eliminateFirstPref();
-        if (isEmpty) break;
-        // Otherwise, continue looking for a standing next-preference.
-        firstPref = (*list_start)->first.firstPreference();
-      }
-      if (isEmpty) {
-        // If the resulting ballot was emptied, then we delete it from
-        // the full set of ballots, and we don't redistribute it.
-        ballots.erase(*list_start);
-      } else {
-        // If it is not empty, we add the ballotcount to the next *standing*
-        // candidates' tally.
-        tally_groups[firstPref].push_back(*list_start);
-        tallies[firstPref] += (*list_start)->second;
-      }
-      // Now that the ballot has been redistributed, continue
-      list_start = tally_groups[elim].erase(list_start);
-    }
-    ++nEliminations;
+  ballots.resize(offsets[nCandidates]);
+  std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+  for (const auto &bc : ballotcounts) {
+    if (bc.first.nPreferences() == 0) continue;
+    ballots[next[bc.first.firstPreference()]++] = bc;
   }
+}
+
+std::vector<unsigned> socialChoiceIRV(
+    const std::vector<IRVBallotCount> &ballotcounts, unsigned nCandidates,
+    PRNG *engine) {
+  return socialChoiceIRV(IRVBallotGroups(ballotcounts, nCandidates), {},
+                         nCandidates, engine);
+}
 
-  return out;
+std::vector<unsigned> socialChoiceIRV(
+    const IRVBallotGroups &fixed,
+    const std::vector<IRVBallotCount> &ballotcounts, unsigned nCandidates,
+    PRNG *engine) {
+  IRVTabulator tabulator(nCandidates);
+  return tabulator.tabulate(fixed, ballotcounts, engine);
 }
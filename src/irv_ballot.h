@@ -6,13 +6,19 @@
  * Description:      This file declares the IRVBallot type. A complete IRV
  *                   ballot is a permutation on N candidates. A partial IRV
  *                   ballot is one which gives a partial ordering of the N
- *                   candidates.
+ *                   candidates. Ballots are stored as a fixed-width array of
+ *                   8-bit candidate indices, so that constructing one does
+ *                   not allocate unless the contest is very large.
  *****************************************************************************/
 
 #ifndef IRV_BALLOT_H
 #define IRV_BALLOT_H
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
 #include <limits>
 #include <list>
 #include <random>
@@ -20,20 +26,99 @@
 #include <string>
 #include <vector>
 
+#include "prng.h"
+
 class IRVBallot {
- public:
-  // The IRV Ballot in list representation with candidate indices in order of
+ private:
+  // The maximum number of preferences which can be stored inline. Ballots
+  // with more preferences than this (or referencing a candidate index which
+  // does not fit in 8 bits) fall back to a heap-allocated array.
+  static constexpr unsigned nInline = 24;
+
+  // The number of preferences specified by the ballot.
+  unsigned n = 0;
+
+  // Whether the preferences are stored inline as 8-bit candidate indices.
+  bool isPacked = true;
+
+  // The IRV Ballot in array representation with candidate indices in order of
   // preference as elements, e.g. {0, 1, 2, 3, 4} or {4, 3, 2}.
-  std::list<unsigned> preferences;
+  union {
+    uint8_t packed[nInline];
+    unsigned *wide;
+  };
+
+  /*! \brief Allocates storage for n_ preferences.
+   *
+   *  Chooses the packed representation when the preferences fit inline,
+   * otherwise allocates a wide array on the heap.
+   *
+   * \param n_ The number of preferences to store.
+   *
+   * \param maxIndex The largest candidate index which will be stored.
+   */
+  void allocate(unsigned n_, unsigned maxIndex);
+
+  /*! \brief Stores a preference at the given position.
+   *
+   * \param i The position of the preference in the ballot.
+   *
+   * \param c The candidate index.
+   */
+  void set(unsigned i, unsigned c) {
+    if (isPacked) {
+      packed[i] = static_cast<uint8_t>(c);
+    } else {
+      wide[i] = c;
+    }
+  }
+
+  // Frees any heap-allocated preferences.
+  void release() {
+    if (!isPacked) delete[] wide;
+    isPacked = true;
+    n = 0;
+  }
+
+ public:
+  /*! \brief Constructs an empty IRVBallot.
+   */
+  IRVBallot() {}
 
   /*! \brief The IRVBallot constructor.
    *
-   * \param preferences A list representation of an IRV ballot consisting of
+   * \param preferences A vector representation of an IRV ballot consisting of
    * candidate indices in order of preference.
    *
    * \return A ballot with the specified preferences.
    */
-  IRVBallot(std::list<unsigned> preferences);
+  IRVBallot(const std::vector<unsigned> &preferences)
+      : IRVBallot(preferences.begin(), preferences.end()) {}
+
+  /*! \brief Constructs an IRVBallot from a range of candidate indices.
+   *
+   * \param first An iterator to the first preference.
+   *
+   * \param last An iterator past the last preference.
+   *
+   * \return A ballot with the specified preferences.
+   */
+  template <typename InputIt>
+  IRVBallot(InputIt first, InputIt last) {
+    unsigned maxIndex = 0;
+    for (InputIt it = first; it != last; ++it)
+      maxIndex = std::max(maxIndex, static_cast<unsigned>(*it));
+    allocate(std::distance(first, last), maxIndex);
+    for (unsigned i = 0; first != last; ++first, ++i) set(i, *first);
+  }
+
+  // Copy and move semantics.
+  IRVBallot(const IRVBallot &b);
+  IRVBallot(IRVBallot &&b) noexcept;
+  IRVBallot &operator=(const IRVBallot &b);
+  IRVBallot &operator=(IRVBallot &&b) noexcept;
+
+  ~IRVBallot() { release(); }
 
   /*! \brief Returns the number of preferences specified by the ballot
    *
@@ -43,7 +128,17 @@ class IRVBallot {
    *
    * \return The number of specified preferences.
    */
-  unsigned nPreferences() const { return preferences.size(); }
+  unsigned nPreferences() const { return n; }
+
+  /*! \brief Returns the preference at the given position.
+   *
+   * \param i The position of the preference, starting from 0.
+   *
+   * \return The candidate index of the i'th preference.
+   */
+  unsigned operator[](unsigned i) const {
+    return isPacked ? packed[i] : wide[i];
+  }
 
   /*! \brief Returns the first preference of the ballot.
    *
@@ -52,7 +147,7 @@ class IRVBallot {
    *
    * \return The first preference of the ballot.
    */
-  unsigned firstPreference() const { return preferences.front(); }
+  unsigned firstPreference() const { return (*this)[0]; }
 
   /*! \brief Eliminate the first candidate.
    *
@@ -63,6 +158,17 @@ class IRVBallot {
    */
   bool eliminateFirstPref();
 
+  /*! \brief Computes a hash of the ballot.
+   *
+   *  Packed ballots are hashed eight preferences at a time. Ballots are
+   * packed whenever their preferences fit inline, including after
+   * `eliminateFirstPref`, so equal ballots always share a representation, and
+   * hence a hash.
+   *
+   * \return A hash of the ballot's preferences.
+   */
+  size_t hash() const;
+
   /*! \brief Returns whether the provided ballot is equal to this one.
    *
    *  Checks whether another instance of IRVBallot represents the same ballot.
@@ -71,7 +177,7 @@ class IRVBallot {
    *
    * \return A boolean representing whether or not the two ballots are equal.
    */
-  bool operator==(const IRVBallot &b);
+  bool operator==(const IRVBallot &b) const;
 
   /*! \breif Defines a comparison < on IRV ballots.
    *
@@ -85,22 +191,87 @@ class IRVBallot {
   bool operator<(const IRVBallot &b) const;
 };
 
+/*! \brief Hashes an IRVBallot.
+ *
+ *  Allows IRVBallots to be used as keys of unordered containers, for example
+ * when aggregating identical ballots.
+ */
+namespace std {
+template <>
+struct hash<IRVBallot> {
+  size_t operator()(const IRVBallot &b) const noexcept { return b.hash(); }
+};
+}  // namespace std
+
 typedef std::pair<IRVBallot, unsigned> IRVBallotCount;
 
+/*! \brief A fixed set of ballot counts, grouped by first preference.
+ *
+ *  When many IRV elections share a common set of ballots (for example, the
+ * observed ballots in every election simulated from a posterior), grouping
+ * them once allows each election to start from the precomputed first
+ * preference tallies rather than copying and re-tallying the shared ballots.
+ */
+class IRVBallotGroups {
+ public:
+  // The non-empty ballot counts, ordered by first preference.
+  std::vector<IRVBallotCount> ballots{};
+
+  // The ballots with first preference c are ballots[offsets[c]] up to (but
+  // not including) ballots[offsets[c + 1]].
+  std::vector<size_t> offsets{};
+
+  // The first preference tally for each candidate.
+  std::vector<unsigned> tallies{};
+
+  /*! \brief Groups a set of ballot counts by first preference.
+   *
+   * \param ballotcounts The ballot counts to group. Empty ballots are
+   * discarded.
+   *
+   * \param nCandidates The number of candidates in the election.
+   */
+  IRVBallotGroups(const std::vector<IRVBallotCount> &ballotcounts,
+                  unsigned nCandidates);
+};
+
 /*! \brief Evaluates the outcome of an IRV election.
  *
  *  Given a set of ballots, this applies the social choice function to determine
  * the elimination order.
  *
  * \param ballotcounts A reference to a set of ballot counts to conduct the
- * social choice function with. The reference object will be deleted.
+ * social choice function with.
+ *
+ * \param engine A pointer to a PRNG for tie-breaking.
+ *
+ * \return A list of candidate indices in order of elimination.
+ */
+std::vector<unsigned> socialChoiceIRV(
+    const std::vector<IRVBallotCount> &ballotcounts, unsigned nCandidates,
+    PRNG *engine);
+
+/*! \brief Evaluates the outcome of an IRV election consisting of a fixed set
+ * of grouped ballots along with some additional ballots.
+ *
+ *  Neither set of ballots is modified. The fixed ballots are only visited
+ * when their current preference is eliminated, so the cost of each election
+ * is driven by the additional ballots rather than by the fixed set. To avoid
+ * allocating scratch space on every call, use an `IRVTabulator` directly.
+ *
+ * \param fixed The grouped ballots common to many elections.
+ *
+ * \param ballotcounts The additional ballot counts for this election.
+ *
+ * \param nCandidates The number of candidates in the election.
  *
- * \param engine A pointer to a mt19937 PRNG for tie-breaking.
+ * \param engine A pointer to a PRNG for tie-breaking.
  *
  * \return A list of candidate indices in order of elimination.
  */
-std::vector<unsigned> socialChoiceIRV(std::list<IRVBallotCount> &ballotcounts,
-                                      unsigned nCandidates,
-                                      std::mt19937 *engine);
+std::vector<unsigned> socialChoiceIRV(
+    const IRVBallotGroups &fixed,
+    const std::vector<IRVBallotCount> &ballotcounts, unsigned nCandidates,
+    PRNG *engine);
 
 #endif /* IRV_BALLOT_H */
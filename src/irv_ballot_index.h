@@ -0,0 +1,222 @@
+/******************************************************************************
+ * File:             irv_ballot_index.h
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      This file implements the IRVBallotIndex, which numbers the
+ *                   valid ballots of an IRV Dirichlet-tree consecutively from
+ *                   zero. Ballots are numbered in the order they are visited
+ *                   by a depth-first traversal of the tree, where each node
+ *                   visits the ballots which terminate there before its'
+ *                   children, and orders its' children by the path swaps of
+ *                   `IRVNode`. A ballot can therefore be stored as a single
+ *                   64-bit id, and dense arrays indexed by id follow the
+ *                   layout of the tree.
+ *****************************************************************************/
+
+#ifndef IRV_BALLOT_INDEX_H
+#define IRV_BALLOT_INDEX_H
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+class IRVBallotIndex {
+ public:
+  // The largest number of preferences which can be indexed. Every node
+  // above the leaves has at least two branches, so longer ballots have too
+  // many ids for 64 bits.
+  static constexpr unsigned maxLength = 64;
+
+  // The id returned for a ballot which is not valid.
+  static constexpr uint64_t noIndex = std::numeric_limits<uint64_t>::max();
+
+ private:
+  // The number of candidates.
+  unsigned nCandidates = 0;
+
+  // The minimum number of preferences of a valid ballot.
+  unsigned minDepth = 0;
+
+  // The number of preferences of a complete ballot. Ballots are truncated to
+  // this length, as a ballot with a single candidate remaining is complete.
+  unsigned leafDepth = 0;
+
+  // Whether every valid ballot has an id below `noIndex`.
+  bool isValid = false;
+
+  // The number of valid ballots which begin with a given d preferences, at
+  // index d.
+  std::array<uint64_t, maxLength + 1> sizes{};
+
+  /*! \brief Finds the path position of a candidate after the swaps made to
+   * reach a node.
+   *
+   * \param c The candidate, which is not among the first d preferences.
+   *
+   * \param swaps The path position chosen at each depth above the node.
+   *
+   * \param d The depth of the node.
+   */
+  static constexpr unsigned positionOf(unsigned c, const unsigned *swaps,
+                                       unsigned d) {
+    unsigned pos = c;
+    for (unsigned k = 0; k < d; ++k) {
+      if (pos == k) pos = swaps[k];
+    }
+    return pos;
+  }
+
+  /*! \brief Finds the candidate at a path position after the swaps made to
+   * reach a node.
+   *
+   * \param pos The path position, which is at least d.
+   *
+   * \param swaps The path position chosen at each depth above the node.
+   *
+   * \param d The depth of the node.
+   */
+  static constexpr unsigned candidateAt(unsigned pos, const unsigned *swaps,
+                                        unsigned d) {
+    for (unsigned k = d; k-- > 0;) {
+      if (pos == swaps[k]) {
+        pos = k;
+      } else if (pos == k) {
+        pos = swaps[k];
+      }
+    }
+    return pos;
+  }
+
+  /*! \brief Visits the valid ballots which begin with a path prefix.
+   *
+   * \param depth The length of the prefix.
+   *
+   * \param id The id of the first ballot visited, which is advanced past the
+   * last.
+   *
+   * \param path The path to the prefix. It is restored before returning.
+   *
+   * \param visit The function to call for each ballot.
+   */
+  template <typename Visit>
+  void visitNode(unsigned depth, uint64_t &id, std::vector<unsigned> &path,
+                 Visit &visit) const {
+    if (depth == leafDepth || depth >= minDepth)
+      visit(id++, path.data(), path.data() + depth);
+    if (depth == leafDepth) return;
+    for (unsigned i = 0; i < nCandidates - depth; ++i) {
+      std::swap(path[depth], path[depth + i]);
+      visitNode(depth + 1, id, path, visit);
+      std::swap(path[depth], path[depth + i]);
+    }
+  }
+
+ public:
+  /*! \brief Constructs an empty index, with no valid ballots.
+   */
+  constexpr IRVBallotIndex() {}
+
+  /*! \brief Constructs the index of valid ballots for an IRV Dirichlet-tree.
+   *
+   * \param nCandidates_ The number of candidates.
+   *
+   * \param minDepth_ The minimum number of preferences of a valid ballot.
+   *
+   * \param maxDepth_ The maximum number of preferences of a valid ballot.
+   */
+  constexpr IRVBallotIndex(unsigned nCandidates_, unsigned minDepth_,
+                           unsigned maxDepth_)
+      : nCandidates(nCandidates_), minDepth(minDepth_) {
+    leafDepth = maxDepth_ < nCandidates ? maxDepth_ : nCandidates - 1;
+    if (nCandidates == 0 || leafDepth > maxLength || minDepth > leafDepth)
+      return;
+    sizes[leafDepth] = 1;
+    for (unsigned d = leafDepth; d-- > 0;) {
+      uint64_t nChildren = nCandidates - d;
+      if (sizes[d + 1] > (noIndex - 1) / nChildren) return;
+      sizes[d] = nChildren * sizes[d + 1] + (d >= minDepth);
+    }
+    isValid = true;
+  }
+
+  /*! \brief Indicates whether every valid ballot has a 64-bit id.
+   */
+  constexpr bool valid() const { return isValid; }
+
+  /*! \brief Gets the number of valid ballots.
+   */
+  constexpr uint64_t size() const { return isValid ? sizes[0] : 0; }
+
+  /*! \brief Computes the id of a ballot.
+   *
+   *  Preferences beyond the length of a complete ballot are ignored, as they
+   * are by the Dirichlet-tree.
+   *
+   * \param b The ballot, providing `nPreferences()` and `operator[]`.
+   *
+   * \return The id of the ballot, or `noIndex` if it has fewer than
+   * `minDepth` preferences or the index is not valid.
+   */
+  template <typename Ballot>
+  constexpr uint64_t rank(const Ballot &b) const {
+    unsigned n = b.nPreferences() < leafDepth ? b.nPreferences() : leafDepth;
+    if (!isValid || n < minDepth) return noIndex;
+    unsigned swaps[maxLength] = {};
+    uint64_t id = 0;
+    for (unsigned d = 0; d < n; ++d) {
+      // Skip the ballot terminating at this node, then the earlier children.
+      if (d >= minDepth) ++id;
+      unsigned pos = positionOf(b[d], swaps, d);
+      id += (pos - d) * sizes[d + 1];
+      swaps[d] = pos;
+    }
+    return id;
+  }
+
+  /*! \brief Recovers the preferences of a ballot from its' id.
+   *
+   * \param id The id of a valid ballot, less than `size()`.
+   *
+   * \param out The candidates are written to out[0], out[1], and so on.
+   *
+   * \return The number of preferences of the ballot.
+   */
+  template <typename OutputIt>
+  constexpr unsigned unrank(uint64_t id, OutputIt out) const {
+    unsigned swaps[maxLength] = {};
+    unsigned d = 0;
+    for (; d < leafDepth; ++d) {
+      if (d >= minDepth) {
+        if (id == 0) break;
+        --id;
+      }
+      unsigned pos = d + static_cast<unsigned>(id / sizes[d + 1]);
+      id %= sizes[d + 1];
+      out[d] = candidateAt(pos, swaps, d);
+      swaps[d] = pos;
+    }
+    return d;
+  }
+
+  /*! \brief Visits every valid ballot in order of id.
+   *
+   *  This is much faster than calling `unrank` for every id.
+   *
+   * \param path The default path, where path[c] = c. It is restored before
+   * returning.
+   *
+   * \param visit Called as visit(id, first, last) for each valid ballot,
+   * where [first, last) are the preferences of the ballot.
+   */
+  template <typename Visit>
+  void forEach(std::vector<unsigned> &path, Visit visit) const {
+    if (!isValid) return;
+    uint64_t id = 0;
+    visitNode(0, id, path, visit);
+  }
+};
+
+#endif /* IRV_BALLOT_INDEX_H */
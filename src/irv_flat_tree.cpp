@@ -0,0 +1,239 @@
+/******************************************************************************
+ * File:             irv_flat_tree.cpp
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      This file implements the FlatIRVTree class as outlined in
+ *                   `irv_flat_tree.h`.
+ *****************************************************************************/
+#include "irv_flat_tree.h"
+
+void FlatIRVTree::build(IRVNode *root, IRVParameters *parameters_,
+                        bool enumerate) {
+  parameters = parameters_;
+  nodes.clear();
+  gammas.clear();
+  children.clear();
+  branches.clear();
+
+  // Visit the nodes in breadth-first order. Each node's children are assigned
+  // indices as they are queued, so the queue is simply the node list itself.
+  // Ballots longer than `maxDepth` still create nodes below it, but these are
+  // never sampled and have no prior, so they are not flattened.
+  unsigned maxDepth = parameters->getMaxDepth();
+  std::vector<IRVNode *> queue{root};
+  for (size_t i = 0; i < queue.size(); ++i) {
+    IRVNode *node = queue[i];
+    unsigned nStored = node->nStored;
+    nodes.push_back({node->depth, node->nChildren, nStored, gammas.size(),
+                     children.size(), branches.size()});
+    double a0 = parameters->priorGamma(node->depth).getA();
+    for (unsigned k = 0; k < nStored; ++k)
+      gammas.emplace_back(node->as[k] + a0);
+    gammas.emplace_back(node->as[node->capacity] + a0);
+    if (nStored < node->nChildren) {
+      branches.insert(branches.end(), node->branches,
+                      node->branches + nStored);
+      branches.push_back(node->nChildren);
+    }
+    for (unsigned k = 0; k < nStored; ++k) {
+      if (node->children[k] == nullptr || node->depth + 1 >= maxDepth) {
+        children.push_back(noChild);
+      } else {
+        children.push_back(queue.size());
+        queue.push_back(node->children[k]);
+      }
+    }
+  }
+
+  // A tree which reduces to a Dirichlet distribution is equivalent to a
+  // single Dirichlet over the valid ballots, with each ballot's parameter
+  // being that of the branch which leads to it.
+  ballotIndex = IRVBallotIndex();
+  leafGammas.clear();
+  if (enumerate && parameters->getVD() &&
+      parameters->getNCandidates() <= maxEnumeratedCandidates) {
+    ballotIndex = IRVBallotIndex(parameters->getNCandidates(),
+                                 parameters->getMinDepth(),
+                                 parameters->getMaxDepth());
+    leafGammas.reserve(ballotIndex.size());
+    enumerateNode(0);
+  }
+}
+
+void FlatIRVTree::enumerateNode(unsigned idx) {
+  const Node &node = nodes[idx];
+  unsigned depth = node.depth;
+  const GammaSampler *nodeGammas = gammas.data() + node.gammaOffset;
+  const unsigned *nodeChildren = children.data() + node.childOffset;
+
+  if (depth >= parameters->getMinDepth())
+    leafGammas.push_back(nodeGammas[node.nStored]);
+
+  for (unsigned i = 0; i < node.nChildren; ++i) {
+    unsigned k = find(node, i);
+    const GammaSampler &g =
+        k < node.nStored ? nodeGammas[k] : parameters->priorGamma(depth);
+    unsigned child = k < node.nStored ? nodeChildren[k] : noChild;
+    if (depth == parameters->getMaxDepth() - 1) {
+      leafGammas.push_back(g);
+    } else if (child == noChild) {
+      enumerateLazy(depth + 1, g.getA());
+    } else {
+      enumerateNode(child);
+    }
+  }
+}
+
+void FlatIRVTree::enumerateLazy(unsigned depth, double a) {
+  unsigned nCandidates = parameters->getNCandidates();
+
+  if (depth == nCandidates - 1 || depth == parameters->getMaxDepth()) {
+    leafGammas.emplace_back(a);
+    return;
+  }
+
+  double a0 = parameters->priorGamma(depth).getA();
+  if (depth >= parameters->getMinDepth())
+    leafGammas.push_back(parameters->priorGamma(depth));
+  for (unsigned i = 0; i < nCandidates - depth; ++i)
+    enumerateLazy(depth + 1, a0);
+}
+
+bool FlatIRVTree::update(const IRVBallot &b, std::vector<unsigned> &path,
+                         unsigned count) {
+  if (!updateNode(0, b, path, count)) return false;
+  // Ballots with fewer than `minDepth` preferences have no id, and are not
+  // sampled.
+  if (!leafGammas.empty()) {
+    uint64_t id = ballotIndex.rank(b);
+    if (id != IRVBallotIndex::noIndex)
+      leafGammas[id] = GammaSampler(leafGammas[id].getA() + count);
+  }
+  return true;
+}
+
+bool FlatIRVTree::updateNode(unsigned idx, const IRVBallot &b,
+                             std::vector<unsigned> &path, unsigned count) {
+  const Node &node = nodes[idx];
+  GammaSampler *nodeGammas = gammas.data() + node.gammaOffset;
+
+  // If the next preference is not defined, then we increment the halting
+  // parameter and stop traversing.
+  if (node.depth == b.nPreferences()) {
+    GammaSampler &g = nodeGammas[node.nStored];
+    g = GammaSampler(g.getA() + count);
+    return true;
+  }
+
+  // Find the index of the next candidate, and increment the corresponding
+  // parameter.
+  unsigned nextCandidate = b[node.depth];
+  unsigned i = node.depth;
+  while (path[i] != nextCandidate) ++i;
+  unsigned k = find(node, i - node.depth);
+
+  // The pointer-linked tree would add a branch to a sparse node here.
+  if (k == node.nStored) return false;
+  GammaSampler &g = nodeGammas[k];
+  g = GammaSampler(g.getA() + count);
+
+  // The leaves are not stored, as in `IRVNode::update`, and nor are the
+  // nodes below `maxDepth`.
+  if (node.nChildren == 2 || node.depth + 1 >= parameters->getMaxDepth())
+    return true;
+
+  // The pointer-linked tree would create a new node here.
+  unsigned child = children[node.childOffset + k];
+  if (child == noChild) return false;
+
+  std::swap(path[node.depth], path[i]);
+  bool updated = updateNode(child, b, path, count);
+  std::swap(path[node.depth], path[i]);
+  return updated;
+}
+
+void FlatIRVTree::sampleNode(unsigned idx, unsigned count,
+                             std::vector<unsigned> &path,
+                             SampleBuffer<IRVBallot> &buffer,
+                             PRNG *engine) const {
+  const Node &node = nodes[idx];
+  unsigned depth = node.depth;
+  unsigned nChildren = node.nChildren;
+  const GammaSampler *nodeGammas = gammas.data() + node.gammaOffset;
+  const unsigned *nodeChildren = children.data() + node.childOffset;
+
+  unsigned minDepth = parameters->getMinDepth();
+  unsigned maxDepth = parameters->getMaxDepth();
+
+  unsigned nOutcomes = nChildren + (depth >= minDepth);
+
+  // Get Dirichlet-multinomial counts for next-preference selections below
+  // current node, using the precomputed posterior gamma samplers.
+  std::vector<unsigned> &mnomCounts = buffer.counts[depth];
+  bool sparse = node.nStored < nChildren;
+  const unsigned *nodeBranches = branches.data() + node.branchOffset;
+  if (sparse) {
+    rDirichletMultinomial(count, parameters->priorGamma(depth), nodeGammas,
+                          nodeBranches, node.nStored + 1, nOutcomes,
+                          buffer.ps[depth], mnomCounts, engine);
+  } else {
+    rDirichletMultinomial(count, nodeGammas, nOutcomes, buffer.ps[depth],
+                          mnomCounts, engine);
+  }
+
+  // Add terminal node ballots
+  if (depth >= minDepth && mnomCounts[nChildren] > 0) {
+    buffer.outcomes.emplace_back(IRVBallot(path.begin(), path.begin() + depth),
+                                 mnomCounts[nChildren]);
+  }
+
+  // If the ballot is one preference from being completely specified, add the
+  // completed ballots to the output.
+  if (depth == maxDepth - 1) {
+    for (unsigned i = 0; i < nChildren; ++i) {
+      if (mnomCounts[i] == 0) continue;
+      std::swap(path[depth], path[depth + i]);
+      buffer.outcomes.emplace_back(
+          IRVBallot(path.begin(), path.begin() + depth + 1), mnomCounts[i]);
+      std::swap(path[depth], path[depth + i]);
+    }
+    return;
+  }
+
+  // Otherwise we continue recursively sampling from subtrees, lazily
+  // generating samples from a uniform Dirichlet-tree where no node exists.
+  // The stored branches of a sparse node are visited alongside.
+  unsigned k = 0;
+  for (unsigned i = 0; i < nChildren; ++i) {
+    if (mnomCounts[i] == 0) continue;
+    std::swap(path[depth], path[depth + i]);
+    unsigned child = sparse ? noChild : nodeChildren[i];
+    if (sparse) {
+      // The final branch index, nChildren, ends the search.
+      while (nodeBranches[k] < i) ++k;
+      if (nodeBranches[k] == i) child = nodeChildren[k];
+    }
+    if (child == noChild) {
+      lazyIRVBallots(parameters, mnomCounts[i], path, depth + 1, buffer,
+                     engine);
+    } else {
+      sampleNode(child, mnomCounts[i], path, buffer, engine);
+    }
+    std::swap(path[depth], path[depth + i]);
+  }
+}
+
+void FlatIRVTree::sampleEnumerated(unsigned count,
+                                   std::vector<unsigned> &path,
+                                   SampleBuffer<IRVBallot> &buffer,
+                                   PRNG *engine) const {
+  std::vector<unsigned> &mnomCounts = buffer.counts[0];
+  rDirichletMultinomial(count, leafGammas.data(), leafGammas.size(),
+                        buffer.ps[0], mnomCounts, engine);
+  ballotIndex.forEach(path, [&](uint64_t id, const unsigned *first,
+                                const unsigned *last) {
+    if (mnomCounts[id] > 0)
+      buffer.outcomes.emplace_back(IRVBallot(first, last), mnomCounts[id]);
+  });
+}
@@ -0,0 +1,243 @@
+/******************************************************************************
+ * File:             irv_flat_tree.h
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      This file declares a flattened, read-only representation
+ *                   of an IRV Dirichlet-tree. The interior nodes are stored
+ *                   contiguously in breadth-first order, with the parameters
+ *                   and child indices of every node packed into two shared
+ *                   arrays, so that sampling walks memory with good locality.
+ *                   The parameters are stored as gamma samplers for the
+ *                   posterior, so their constants are only computed once.
+ *                   When the tree reduces to a Dirichlet distribution over a
+ *                   small number of ballots, every valid ballot is also
+ *                   enumerated so that an election can be sampled with a
+ *                   single Dirichlet-multinomial draw.
+ *****************************************************************************/
+#ifndef IRV_FLAT_TREE_H
+#define IRV_FLAT_TREE_H
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "distributions.h"
+#include "irv_ballot.h"
+#include "irv_ballot_index.h"
+#include "irv_node.h"
+#include "tree_node.h"
+
+class FlatIRVTree {
+ private:
+  // An interior node of the flattened tree.
+  struct Node {
+    // The depth of the node in the tree.
+    unsigned depth;
+    // The number of possible next-preferences from this node.
+    unsigned nChildren;
+    // The number of branches stored, which is nChildren unless the node is
+    // sparse.
+    unsigned nStored;
+    // The offset of the node's nStored + 1 parameters in `gammas`, the last
+    // being for incomplete ballots.
+    size_t gammaOffset;
+    // The offset of the node's nStored child indices in `children`.
+    size_t childOffset;
+    // When the node is sparse, the offset of its' nStored + 1 branch indices
+    // in `branches`.
+    size_t branchOffset;
+  };
+
+  // Marks a child which has not been initialized in the tree.
+  static constexpr unsigned noChild = std::numeric_limits<unsigned>::max();
+
+  // The parameters of the tree which was flattened.
+  IRVParameters *parameters = nullptr;
+
+  // The interior nodes in breadth-first order. The root is nodes[0].
+  std::vector<Node> nodes{};
+
+  // The gamma samplers for the posterior parameters of every node,
+  // concatenated. The posterior parameters are the node's `as` plus the prior
+  // parameter for its' depth.
+  std::vector<GammaSampler> gammas{};
+
+  // The index in `nodes` of every child of every node, concatenated.
+  std::vector<unsigned> children{};
+
+  // The index of every stored branch of every sparse node, concatenated,
+  // each node's ending with nChildren for the branch of incomplete ballots.
+  // As in `IRVNode`, the branches which are not stored have the prior
+  // parameter and no child.
+  std::vector<unsigned> branches{};
+
+  /*! \brief Finds the storage for a branch of a node.
+   *
+   * \param node The node.
+   *
+   * \param i The index of the branch.
+   *
+   * \return The index of the branch among the node's stored branches, or
+   * `node.nStored` if the branch is not stored.
+   */
+  unsigned find(const Node &node, unsigned i) const {
+    if (node.nStored == node.nChildren) return i;
+    const unsigned *first = branches.data() + node.branchOffset;
+    const unsigned *last = first + node.nStored;
+    const unsigned *pos = std::lower_bound(first, last, i);
+    return pos != last && *pos == i ? pos - first : node.nStored;
+  }
+
+  // The largest number of candidates for which the valid ballots are
+  // enumerated. Eight candidates allow at most 69281 valid ballots.
+  static constexpr unsigned maxEnumeratedCandidates = 8;
+
+  // When the tree reduces to a Dirichlet distribution and has few enough
+  // candidates, the ids of the valid ballots, and the gamma sampler for the
+  // posterior parameter of each valid ballot at the index of its' id. The
+  // gamma samplers are empty otherwise.
+  IRVBallotIndex ballotIndex{};
+  std::vector<GammaSampler> leafGammas{};
+
+  /*! \brief Enumerates the valid ballots in the sub-tree rooted at a node.
+   *
+   *  Visits the outcomes in the same order as `sampleNode`, which is the
+   * order of their ids, appending the posterior parameter of each valid
+   * ballot to `leafGammas`.
+   *
+   * \param idx The index of the node in `nodes`.
+   */
+  void enumerateNode(unsigned idx);
+
+  /*! \brief Enumerates the valid ballots below a node which is not stored.
+   *
+   *  Mirrors `lazyIRVBallots`, where every branch has the prior parameter.
+   *
+   * \param depth The depth of the node.
+   *
+   * \param a The parameter of the branch leading to the node, which is the
+   * parameter of the ballot if the node is a leaf.
+   */
+  void enumerateLazy(unsigned depth, double a);
+
+  /*! \brief Samples valid ballots from the sub-tree rooted at a node.
+   *
+   *  Mirrors `IRVNode::sample`, consuming the PRNG in the same order so that
+   * both representations produce identical samples.
+   *
+   * \param idx The index of the node in `nodes`.
+   *
+   * \param count The number of ballots to sample.
+   *
+   * \param path The path to this node, represented by a permutation on the
+   * candidates. It is restored before returning.
+   *
+   * \param buffer The buffer to append (ballot, count) pairs to.
+   *
+   * \param engine A PRNG for random sampling.
+   */
+  void sampleNode(unsigned idx, unsigned count, std::vector<unsigned> &path,
+                  SampleBuffer<IRVBallot> &buffer, PRNG *engine) const;
+
+  /*! \brief Updates the parameters of the sub-tree rooted at a node.
+   *
+   * \param idx The index of the node in `nodes`.
+   *
+   * \param b The ballot to observe.
+   *
+   * \param path The path to this node. It is restored before returning.
+   *
+   * \param count The number of times to observe the ballot.
+   *
+   * \return False if a required node is missing from the flattened tree.
+   */
+  bool updateNode(unsigned idx, const IRVBallot &b, std::vector<unsigned> &path,
+                  unsigned count);
+
+ public:
+  /*! \brief Flattens a pointer-linked tree.
+   *
+   *  Replaces any existing contents with a copy of the tree rooted at `root`.
+   * The prior parameters are read from `parameters_`, so the tree must be
+   * rebuilt whenever they change.
+   *
+   * \param root The root of the tree to flatten.
+   *
+   * \param parameters_ The parameters of the tree.
+   *
+   * \param enumerate Whether to enumerate the valid ballots when the tree
+   * reduces to a Dirichlet distribution over few enough ballots.
+   */
+  void build(IRVNode *root, IRVParameters *parameters_, bool enumerate = true);
+
+  /*! \brief Updates the flattened parameters in place.
+   *
+   *  Applies the same parameter update as `IRVNode::update`, provided that no
+   * new interior nodes are required to do so. The parameter of the
+   * enumerated ballot is found from its' id.
+   *
+   * \param b The ballot to observe.
+   *
+   * \param path The default path for the tree. It is restored before
+   * returning.
+   *
+   * \param count The number of times to observe the ballot.
+   *
+   * \return False if the update requires a node which is not in the
+   * flattened tree, in which case it must be rebuilt before sampling again.
+   */
+  bool update(const IRVBallot &b, std::vector<unsigned> &path,
+              unsigned count);
+
+  /*! \brief Gets the number of enumerated ballots.
+   *
+   * \return The number of valid ballots, or zero if they are not enumerated.
+   */
+  size_t getNEnumerated() const { return leafGammas.size(); }
+
+  /*! \brief Samples valid ballots from the enumerated ballots.
+   *
+   *  Draws from a single Dirichlet-multinomial over every valid ballot, which
+   * has the same distribution as sampling each node of the tree. The valid
+   * ballots must be enumerated.
+   *
+   * \param count The number of ballots to sample.
+   *
+   * \param path The default path for the tree. It is restored before
+   * returning.
+   *
+   * \param buffer The buffer to append (ballot, count) pairs to.
+   *
+   * \param engine A PRNG for random sampling.
+   */
+  void sampleEnumerated(unsigned count, std::vector<unsigned> &path,
+                        SampleBuffer<IRVBallot> &buffer, PRNG *engine) const;
+
+  /*! \brief Samples valid ballots from the flattened tree.
+   *
+   *  The enumerated ballots are sampled when there are no more of them than
+   * ballots to sample. Smaller samples leave most branches of the tree empty,
+   * so visiting only the non-empty branches is faster.
+   *
+   * \param count The number of ballots to sample.
+   *
+   * \param path The default path for the tree. It is restored before
+   * returning.
+   *
+   * \param buffer The buffer to append (ballot, count) pairs to.
+   *
+   * \param engine A PRNG for random sampling.
+   */
+  void sample(unsigned count, std::vector<unsigned> &path,
+              SampleBuffer<IRVBallot> &buffer, PRNG *engine) const {
+    if (!leafGammas.empty() && count >= leafGammas.size()) {
+      sampleEnumerated(count, path, buffer, engine);
+    } else {
+      sampleNode(0, count, path, buffer, engine);
+    }
+  }
+};
+
+#endif /* IRV_FLAT_TREE_H */
@@ -22,49 +22,43 @@ void IRVParameters::calculateDepthFactors() {
     depthFactors[depth] = f;
     f = f * nChildren;
   }
+  calculatePriorGammas();
 }
 
-std::list<IRVBallotCount> lazyIRVBallots(IRVParameters *params, unsigned count,
-                                         std::vector<unsigned> path,
-                                         unsigned depth, std::mt19937 *engine) {
+void lazyIRVBallots(IRVParameters *params, unsigned count,
+                    std::vector<unsigned> &path, unsigned depth,
+                    SampleBuffer<IRVBallot> &buffer, PRNG *engine) {
   // Get parameters
   unsigned nCandidates = params->getNCandidates();
   double minDepth = params->getMinDepth();
   double maxDepth = params->getMaxDepth();
-  double a0 = params->getA0();
-  if (params->getVD()) a0 = a0 * params->depthFactor(depth);
-
-  std::list<IRVBallotCount> out = {};
-
-  std::vector<unsigned> mnomCounts;
-
-  unsigned nChildren = nCandidates - depth;
-  unsigned nOutcomes = nChildren + (depth >= minDepth);
-
-  std::vector<double> a(nOutcomes);
 
   if (depth == nCandidates - 1 || depth == maxDepth) {
     // If the ballot is completely specified, return count * the specified
     // ballot.
-    IRVBallot b(std::list<unsigned>(path.begin(), path.begin() + depth));
-    out.emplace_back(std::move(b), count);
-    return out;
+    buffer.outcomes.emplace_back(IRVBallot(path.begin(), path.begin() + depth),
+                                 count);
+    return;
   }
 
+  unsigned nChildren = nCandidates - depth;
+  unsigned nOutcomes = nChildren + (depth >= minDepth);
+
   // Otherwise we sample from a Dirichlet-Multinomial distribution to
   // determine how many ballots we sample from each sub-tree (or how many
   // ballots terminate).
 
-  // We start by initializing a to the appropriate values.
-  for (unsigned i = 0; i < nOutcomes; ++i) a[i] = a0;
-  mnomCounts = rDirichletMultinomial(count, a, engine);
+  // Every outcome shares the prior parameter for this depth, whose gamma
+  // sampler is precomputed. These are only defined for interior depths.
+  std::vector<unsigned> &mnomCounts = buffer.counts[depth];
+  rDirichletMultinomial(count, params->priorGamma(depth), nOutcomes,
+                        buffer.ps[depth], mnomCounts, engine);
 
   // Add the ballots which terminate at this node.
   if (depth >= minDepth && mnomCounts[nOutcomes - 1] > 0) {
-    // Create the ballot.
-    IRVBallot b(std::list<unsigned>(path.begin(), path.begin() + depth));
     // Add ballots to output.
-    out.emplace_back(std::move(b), mnomCounts[nOutcomes - 1]);
+    buffer.outcomes.emplace_back(IRVBallot(path.begin(), path.begin() + depth),
+                                 mnomCounts[nOutcomes - 1]);
   }
 
   for (unsigned i = 0; i < nChildren; ++i) {
@@ -74,41 +68,83 @@ std::list<IRVBallotCount> lazyIRVBallots(IRVParameters *params, unsigned count,
     // Update path for recursive sampling.
     std::swap(path[depth], path[depth + i]);
     // Combine results with output.
-    out.splice(out.end(),
-               lazyIRVBallots(params, mnomCounts[i], path, depth + 1, engine));
+    lazyIRVBallots(params, mnomCounts[i], path, depth + 1, buffer, engine);
     // Change the path back for further sampling.
     std::swap(path[depth], path[depth + i]);
   }
+}
 
-  return out;
+IRVNode *IRVNode::create(unsigned depth, IRVParameters *parameters,
+                         Arena *arena) {
+  unsigned nChildren = parameters->getNCandidates() - depth;
+  bool sparse = nChildren >= minSparseChildren;
+  // The node is followed by the parameters (+1 for incomplete ballots) and
+  // child pointers of every branch, or of the first few observed branches
+  // along with their indices when sparse.
+  size_t size = sizeof(IRVNode) +
+                storageSize(sparse ? initialCapacity : nChildren, sparse);
+  void *mem = arena->allocate(size, alignof(IRVNode));
+  return new (mem) IRVNode(depth, parameters, sparse);
 }
 
-IRVNode::IRVNode(unsigned depth_, IRVParameters *parameters_) {
+IRVNode::IRVNode(unsigned depth_, IRVParameters *parameters_, bool sparse) {
   parameters = parameters_;
   nChildren = parameters->getNCandidates() - depth_;
   depth = depth_;
 
-  as = new double[nChildren + 1];  // +1 for incomplete ballots
-  for (unsigned i = 0; i < nChildren + 1; ++i) as[i] = 0.;
-
-  children = new NodeP[nChildren]{nullptr};
+  useStorage(this + 1, sparse ? initialCapacity : nChildren, sparse);
+  nStored = sparse ? 0 : nChildren;
+  for (unsigned i = 0; i < capacity + 1; ++i) as[i] = 0.;
+  for (unsigned i = 0; i < capacity; ++i) children[i] = nullptr;
 }
 
-IRVNode::~IRVNode() {
-  // Destructor must delete the entire sub-tree. Hence, we need to delete any
-  // initialized nodes in the sub-tree before removing the array.
-  delete[] as;
-  for (unsigned i = 0; i < nChildren; ++i) {
-    if (children[i] != nullptr) delete children[i];
+unsigned IRVNode::slot(unsigned i, Arena *arena) {
+  if (branches == nullptr) return i;
+  unsigned k = std::lower_bound(branches, branches + nStored, i) - branches;
+  if (k < nStored && branches[k] == i) return k;
+
+  if (nStored == capacity) {
+    // Move the stored branches to larger storage.
+    double *oldAs = as;
+    NodeP *oldChildren = children;
+    unsigned *oldBranches = branches;
+    unsigned oldCapacity = capacity;
+    bool sparse = 4 * capacity < nChildren;
+    unsigned width = sparse ? 2 * capacity : nChildren;
+    useStorage(arena->allocate(storageSize(width, sparse), alignof(double)),
+               width, sparse);
+    as[width] = oldAs[oldCapacity];
+    if (sparse) {
+      std::copy(oldAs, oldAs + nStored, as);
+      std::copy(oldChildren, oldChildren + nStored, children);
+      std::copy(oldBranches, oldBranches + nStored, branches);
+    } else {
+      std::fill(as, as + nChildren, 0.);
+      std::fill(children, children + nChildren, nullptr);
+      for (unsigned j = 0; j < nStored; ++j) {
+        as[oldBranches[j]] = oldAs[j];
+        children[oldBranches[j]] = oldChildren[j];
+      }
+      nStored = nChildren;
+      return i;
+    }
   }
-  delete[] children;
-}
 
-std::list<IRVBallotCount> IRVNode::sample(unsigned count,
-                                          std::vector<unsigned> path,
-                                          std::mt19937 *engine) {
-  std::list<IRVBallotCount> out = {};
+  // Insert the branch, keeping the branches in ascending order.
+  for (unsigned j = nStored; j > k; --j) {
+    as[j] = as[j - 1];
+    children[j] = children[j - 1];
+    branches[j] = branches[j - 1];
+  }
+  as[k] = 0.;
+  children[k] = nullptr;
+  branches[k] = i;
+  ++nStored;
+  return k;
+}
 
+void IRVNode::sample(unsigned count, std::vector<unsigned> &path,
+                     SampleBuffer<IRVBallot> &buffer, PRNG *engine) {
   unsigned minDepth = parameters->getMinDepth();
   unsigned maxDepth = parameters->getMaxDepth();
   double a0 = parameters->getA0();
@@ -116,19 +152,25 @@ std::list<IRVBallotCount> IRVNode::sample(unsigned count,
 
   unsigned nOutcomes = nChildren + (depth >= minDepth);
 
-  std::vector<double> asPost(nOutcomes);
-  for (unsigned i = 0; i < nOutcomes; ++i) asPost[i] = as[i] + a0;
+  std::vector<double> &asPost = buffer.as[depth];
+  asPost.resize(nOutcomes);
+  if (branches == nullptr) {
+    for (unsigned i = 0; i < nOutcomes; ++i) asPost[i] = as[i] + a0;
+  } else {
+    std::fill(asPost.begin(), asPost.end(), a0);
+    for (unsigned k = 0; k < nStored; ++k) asPost[branches[k]] += as[k];
+    if (nOutcomes > nChildren) asPost[nChildren] += as[capacity];
+  }
 
   // Get Dirichlet-multinomial counts for next-preference selections below
   // current node.
-  std::vector<unsigned> mnomCounts =
-      rDirichletMultinomial(count, asPost, engine);
+  std::vector<unsigned> &mnomCounts = buffer.counts[depth];
+  rDirichletMultinomial(count, asPost, buffer.ps[depth], mnomCounts, engine);
 
   // Add terminal node ballots
   if (depth >= minDepth && mnomCounts[nChildren] > 0) {
-    IRVBallot b(std::list<unsigned>(path.begin(), path.begin() + depth));
-
-    out.emplace_back(std::move(b), mnomCounts[nChildren]);
+    buffer.outcomes.emplace_back(IRVBallot(path.begin(), path.begin() + depth),
+                                 mnomCounts[nChildren]);
   }
 
   // If the ballot is one preference from being completely specified, add the
@@ -140,19 +182,19 @@ std::list<IRVBallotCount> IRVNode::sample(unsigned count,
 
       std::swap(path[depth], path[depth + i]);
 
-      IRVBallot b(std::list<unsigned>(path.begin(), path.begin() + depth + 1));
-
-      out.emplace_back(std::move(b), mnomCounts[i]);
+      buffer.outcomes.emplace_back(
+          IRVBallot(path.begin(), path.begin() + depth + 1), mnomCounts[i]);
 
       std::swap(path[depth], path[depth + i]);
     }
     // Return early since there are no child nodes to sample from.
-    return out;
+    return;
   }
 
   // Otherwise we continue recursively sampling from subtrees. If a subtree is
   // not specified, then we lazily generate samples from a uniform dirichlet
-  // tree.
+  // tree. The stored branches of a sparse node are visited alongside.
+  unsigned k = 0;
   for (unsigned i = 0; i < nChildren; ++i) {
     // Skip if there the sampled count for the subtree is zero.
     if (mnomCounts[i] == 0) continue;
@@ -161,24 +203,27 @@ std::list<IRVBallotCount> IRVNode::sample(unsigned count,
     std::swap(path[depth], path[depth + i]);
 
     // Add the samples to the output.
-    if (children[i] == nullptr) {
-      out.splice(out.end(), lazyIRVBallots(parameters, mnomCounts[i], path,
-                                           depth + 1, engine));
+    NodeP child = branches == nullptr ? children[i] : nullptr;
+    if (branches != nullptr) {
+      while (k < nStored && branches[k] < i) ++k;
+      child = k < nStored && branches[k] == i ? children[k] : nullptr;
+    }
+    if (child == nullptr) {
+      lazyIRVBallots(parameters, mnomCounts[i], path, depth + 1, buffer,
+                     engine);
     } else {
-      out.splice(out.end(), children[i]->sample(mnomCounts[i], path, engine));
+      child->sample(mnomCounts[i], path, buffer, engine);
     }
     std::swap(path[depth], path[depth + i]);
   }
-
-  return out;
 }
 
-void IRVNode::update(const IRVBallot &b, std::vector<unsigned> path,
-                     unsigned count) {
-  /* We traverse the tree such that at each step, b.preferences and
+void IRVNode::update(const IRVBallot &b, std::vector<unsigned> &path,
+                     unsigned count, Arena *arena) {
+  /* We traverse the tree such that at each step, the ballot preferences and
    * path vectors are exactly equal up to the next index.
    *
-   * For example, at depth 0, if b.preferences is {4, 2, 1} and path is {0, 1,
+   * For example, at depth 0, if the ballot is {4, 2, 1} and path is {0, 1,
    * 2, 3, 4}, then we swap indices d=0 and i=4 to obtain the next path of {4,
    * 1, 2, 3, 0} and then proceed to children[i-d]. Then, at depth 1, we will
    * swap indices d=1 and i=2 to obtain {4, 2, 1, 3, 0} and proceed to
@@ -189,21 +234,19 @@ void IRVNode::update(const IRVBallot &b, std::vector<unsigned> path,
   // If the next preference is not defined, then we increment the halting
   // parameter and stop traversing.
   if (depth == b.nPreferences()) {
-    as[nChildren] += count;
+    as[capacity] += count;
     return;
   }
 
   // Determine the next candidate preference.
-  auto it = b.preferences.begin();
-  for (unsigned i = 0; i < depth; ++i) ++it;
-  unsigned nextCandidate = *it;
+  unsigned nextCandidate = b[depth];
 
   // Find the index of the next candidate, and increment the corresponding
   // parameter.
   unsigned i = depth;
   while (path[i] != nextCandidate) ++i;
-  unsigned next_idx = i - depth;
-  as[next_idx] += count;
+  unsigned k = slot(i - depth, arena);
+  as[k] += count;
 
   // Stop traversing if the number of children is 2, since we don't need to
   // access the leaves.
@@ -211,11 +254,51 @@ void IRVNode::update(const IRVBallot &b, std::vector<unsigned> path,
 
   // If the next node is uninitialized, we create a new one with one less
   // candidate to choose from.
-  if (children[next_idx] == nullptr)
-    children[next_idx] = new IRVNode(depth + 1, parameters);
+  if (children[k] == nullptr)
+    children[k] = IRVNode::create(depth + 1, parameters, arena);
 
   // Recursively update the following children down the path, updating the
-  // path as we go.
+  // path as we go and restoring it afterwards.
   std::swap(path[depth], path[i]);
-  children[next_idx]->update(b, path);
+  children[k]->update(b, path, count, arena);
+  std::swap(path[depth], path[i]);
+}
+
+void IRVNode::update(const IRVBallotCount *first, const IRVBallotCount *last,
+                     std::vector<unsigned> &path, Arena *arena) {
+  // Ballots which terminate at this node sort before any ballot which
+  // continues past it, so we first increment the halting parameter with them.
+  while (first != last && first->first.nPreferences() == depth) {
+    as[capacity] += first->second;
+    ++first;
+  }
+
+  // The remaining ballots are grouped by their next preference.
+  while (first != last) {
+    unsigned nextCandidate = first->first[depth];
+    const IRVBallotCount *groupEnd = first;
+    unsigned count = 0;
+    while (groupEnd != last && groupEnd->first[depth] == nextCandidate) {
+      count += groupEnd->second;
+      ++groupEnd;
+    }
+
+    // Find the index of the next candidate, and increment the corresponding
+    // parameter once for the whole group.
+    unsigned i = depth;
+    while (path[i] != nextCandidate) ++i;
+    unsigned k = slot(i - depth, arena);
+    as[k] += count;
+
+    // As in the single ballot update, the leaves are not stored.
+    if (nChildren != 2) {
+      if (children[k] == nullptr)
+        children[k] = IRVNode::create(depth + 1, parameters, arena);
+      std::swap(path[depth], path[i]);
+      children[k]->update(first, groupEnd, path, arena);
+      std::swap(path[depth], path[i]);
+    }
+
+    first = groupEnd;
+  }
 }
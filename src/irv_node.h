@@ -11,10 +11,13 @@
 #ifndef IRV_NODE_H
 #define IRV_NODE_H
 
+#include <algorithm>
 #include <list>
+#include <new>
 #include <random>
 #include <vector>
 
+#include "arena.h"
 #include "distributions.h"
 #include "irv_ballot.h"
 #include "tree_node.h"
@@ -34,6 +37,16 @@ class IRVParameters : Parameters {
   bool vd = false;
   // For storing factor calculations for each depth level in the tree.
   std::vector<double> depthFactors = std::vector<double>(0);
+  // The gamma sampler for the prior parameter at each depth level.
+  std::vector<GammaSampler> priorGammas{};
+
+  /*! \brief Precomputes the gamma sampler for the prior at each depth.
+   */
+  void calculatePriorGammas() {
+    priorGammas.resize(depthFactors.size());
+    for (unsigned depth = 0; depth < depthFactors.size(); ++depth)
+      priorGammas[depth] = GammaSampler(vd ? a0 * depthFactors[depth] : a0);
+  }
 
  public:
   // Canonical constructor
@@ -63,6 +76,18 @@ class IRVParameters : Parameters {
    */
   double depthFactor(unsigned depth) { return depthFactors[depth]; };
 
+  /*! \brief Returns the gamma sampler for the prior parameter of each branch
+   * of an interior node.
+   *
+   * \param depth The depth in the tree.
+   *
+   * \return A sampler for gamma(a0) or, if the tree reduces to a Dirichlet
+   * distribution, gamma(a0 * depthFactor(depth)).
+   */
+  const GammaSampler &priorGamma(unsigned depth) const {
+    return priorGammas[depth];
+  }
+
   /*! \brief Calculates the factors with which to multiple a0 at each depth.
    *
    *  For a tree prior to reduce to a vanilla Dirichlet distribution, the
@@ -140,7 +165,10 @@ class IRVParameters : Parameters {
    *
    * \param a0_ The new prior parameter for the uniform Dirichlet-tree.
    */
-  void setA0(double a0_) { a0 = a0_; }
+  void setA0(double a0_) {
+    a0 = a0_;
+    calculatePriorGammas();
+  }
 
   /*! \brief Change the parameter structure of the prior.
    *
@@ -150,7 +178,10 @@ class IRVParameters : Parameters {
    *
    * \param a0_ The new prior parameter for the uniform Dirichlet-tree.
    */
-  void setVD(bool vd_) { vd = vd_; };
+  void setVD(bool vd_) {
+    vd = vd_;
+    calculatePriorGammas();
+  };
 };
 
 /*! \brief Simulate random ballots from a uniform Dirichlet-tree starting from
@@ -164,45 +195,166 @@ class IRVParameters : Parameters {
  * \param count The number of ballots to sample.
  *
  * \param path The path to the internal node representing the incomplete
- * ballot.
+ * ballot. It is restored before returning.
  *
  * \param depth The current depth in the Dirichlet-tree.
  *
- * \param engine A PRNG for sampling.
+ * \param buffer The buffer to append the valid IRV ballots from the sub-tree
+ * uniquely specified by the arguments to.
  *
- * \return A list of valid IRV ballots from the sub-tree uniquely specified by
- * the arguments.
+ * \param engine A PRNG for sampling.
  */
-std::list<IRVBallotCount> lazyIRVBallots(IRVParameters params, unsigned count,
-                                         std::vector<unsigned> path,
-                                         unsigned depth, std::mt19937 *engine);
+void lazyIRVBallots(IRVParameters *params, unsigned count,
+                    std::vector<unsigned> &path, unsigned depth,
+                    SampleBuffer<IRVBallot> &buffer, PRNG *engine);
+
+class FlatIRVTree;
 
 class IRVNode : public TreeNode<IRVBallot, IRVNode, IRVParameters> {
+ private:
+  friend class FlatIRVTree;
+
+  // Nodes with at least this many children are created sparse. Below the
+  // first few preferences of a large contest, most nodes are reached by only
+  // a handful of ballots, so storing every branch wastes most of the memory.
+  static constexpr unsigned minSparseChildren = 16;
+
+  // The number of branches a sparse node has storage for when created.
+  static constexpr unsigned initialCapacity = 2;
+
+  // The number of branches with storage in `as` and `children`, which is
+  // nChildren unless the node is sparse. The parameter for incomplete ballots
+  // follows them, at as[capacity].
+  unsigned capacity;
+
+  // The number of branches stored, which is nChildren unless the node is
+  // sparse.
+  unsigned nStored;
+
+  // When the node is sparse, the index of the branch stored in each of the
+  // first nStored entries of `as` and `children`, in ascending order. Null
+  // when the node is dense, as every branch is stored at its' own index. The
+  // parameters of the branches not stored are zero, and their children are
+  // null.
+  unsigned *branches;
+
+  /*! \brief Initializes an IRVNode in memory allocated by `create`.
+   *
+   * \param depth_ The depth of this node in the tree.
+   *
+   * \param parameters_ A pointer to the object containing the IRV
+   * distribution parameters.
+   *
+   * \param sparse Whether to store the branches sparsely.
+   */
+  IRVNode(unsigned depth_, IRVParameters *parameters_, bool sparse);
+
+  /*! \brief Computes the size of the storage for a node's branches.
+   *
+   * \param width The number of branches to store.
+   *
+   * \param sparse Whether the branch indices are stored.
+   *
+   * \return The size in bytes.
+   */
+  static size_t storageSize(unsigned width, bool sparse) {
+    return (width + 1) * sizeof(double) + width * sizeof(NodeP) +
+           (sparse ? width * sizeof(unsigned) : 0);
+  }
+
+  /*! \brief Points `as`, `children` and `branches` into uninitialized
+   * storage of `storageSize(width, sparse)` bytes.
+   */
+  void useStorage(void *mem, unsigned width, bool sparse) {
+    capacity = width;
+    as = static_cast<double *>(mem);
+    children = reinterpret_cast<NodeP *>(as + width + 1);
+    branches = sparse ? reinterpret_cast<unsigned *>(children + width)
+                      : nullptr;
+  }
+
+  /*! \brief Finds the storage for a branch, adding it if necessary.
+   *
+   *  A sparse node which is full is moved to storage for twice as many
+   * branches, or becomes dense once that would store at least half of
+   * its' branches. The previous storage remains in the arena until it is
+   * rewound.
+   *
+   * \param i The index of the branch.
+   *
+   * \param arena The arena in which to allocate any new storage.
+   *
+   * \return The index of the branch's entries in `as` and `children`.
+   */
+  unsigned slot(unsigned i, Arena *arena);
+
+  /*! \brief Finds the storage for a branch.
+   *
+   * \param i The index of the branch.
+   *
+   * \return The index of the branch's entries in `as` and `children`, or
+   * `capacity` if the branch is not stored.
+   */
+  unsigned find(unsigned i) const {
+    if (branches == nullptr) return i;
+    const unsigned *pos = std::lower_bound(branches, branches + nStored, i);
+    return pos != branches + nStored && *pos == i ? pos - branches : capacity;
+  }
+
  public:
   using NodeP = IRVNode *;
 
+  // The flattened representation of a tree of IRVNodes.
+  using Flat = FlatIRVTree;
+
   /*! \brief Constructs a new IRVNode.
    *
    *  Constructs an IRVNode representing an internal state of the
    * stochastic process which yields valid IRV ballots by selecting candidates
-   * one-by-one.
+   * one-by-one. The node, its' `as` parameters and its' `children` pointers
+   * are stored contiguously in a single allocation from the arena, and are
+   * released when the arena is rewound. Nodes with many children are sparse,
+   * storing only the branches which have been observed.
    *
-   * \param nChildren_ The number of possible child states (not including the
-   * terminal state). In IRV, this is the number of remaining candidates to
-   * choose from.
-   *
-   * \param depth_ The depth of this node in the tree.
+   * \param depth The depth of this node in the tree.
    *
    * \param parameters A pointer to the object containing the IRV
    * distribution parameters.
    *
-   * \return Returns a new IRV node.
+   * \param arena The arena in which to allocate the node.
+   *
+   * \return Returns a pointer to the new IRV node.
+   */
+  static IRVNode *create(unsigned depth, IRVParameters *parameters,
+                         Arena *arena);
+
+  /*! \brief Indicates whether only the observed branches are stored.
+   */
+  bool isSparse() const { return branches != nullptr; }
+
+  /*! \brief Gets the parameter of a branch.
+   *
+   * \param i The index of the branch, or nChildren for the branch of the
+   * ballots which terminate at this node.
+   *
+   * \return The parameter, which excludes the prior.
    */
-  IRVNode(unsigned depth_, IRVParameters *parameters_);
+  double getA(unsigned i) const {
+    if (i == nChildren) return as[capacity];
+    unsigned k = find(i);
+    return k == capacity ? 0. : as[k];
+  }
 
-  /*! \brief Destroys the node and its' sub-tree.
+  /*! \brief Gets the child below a branch.
+   *
+   * \param i The index of the branch.
+   *
+   * \return The child, or null if it has not been created.
    */
-  ~IRVNode();
+  IRVNode *getChild(unsigned i) const {
+    unsigned k = find(i);
+    return k == capacity ? nullptr : children[k];
+  }
 
   /*! \brief Samples valid ballots from the sub-tree.
    *
@@ -215,12 +367,13 @@ class IRVNode : public TreeNode<IRVBallot, IRVNode, IRVParameters> {
    * \param path The path to this node, represented by a permutation on the
    * candidates.
    *
-   * \param engine A PRNG for random sampling.
+   * \param buffer The buffer to append (ballot, count) pairs sampled from the
+   * subtree to.
    *
-   * \return A list of (ballot, count) pairs sampled from the subtree.
+   * \param engine A PRNG for random sampling.
    */
-  std::list<IRVBallotCount> sample(unsigned count, std::vector<unsigned> path,
-                                   std::mt19937 *engine);
+  void sample(unsigned count, std::vector<unsigned> &path,
+              SampleBuffer<IRVBallot> &buffer, PRNG *engine);
 
   /*! \brief Updates the parameters in the sub-tree to obtain a posterior.
    *
@@ -233,9 +386,31 @@ class IRVNode : public TreeNode<IRVBallot, IRVNode, IRVParameters> {
    * \param path The path to this node.
    *
    * \param count The number of times to observe the ballot.
+   *
+   * \param arena The arena in which to allocate any newly created nodes.
+   */
+  void update(const IRVBallot &b, std::vector<unsigned> &path, unsigned count,
+              Arena *arena);
+
+  /*! \brief Updates the parameters in the sub-tree with a batch of ballots.
+   *
+   *  The ballots are sorted, so those sharing the preferences which lead
+   * to each child are adjacent. Each child's parameter is incremented once by
+   * the total count of its' ballots, and the sub-tree below it is traversed
+   * once for the whole group.
+   *
+   * \param first A pointer to the first (ballot, count) pair. The range must
+   * be sorted in ascending order, and every ballot must share the
+   * preferences leading to this node.
+   *
+   * \param last A pointer past the last (ballot, count) pair.
+   *
+   * \param path The path to this node.
+   *
+   * \param arena The arena in which to allocate any newly created nodes.
    */
-  void update(const IRVBallot &b, std::vector<unsigned> path,
-              unsigned count = 1);
+  void update(const IRVBallotCount *first, const IRVBallotCount *last,
+              std::vector<unsigned> &path, Arena *arena);
 };
 
 #endif /* IRV_NODE_H */
@@ -0,0 +1,90 @@
+/******************************************************************************
+ * File:             irv_tabulator.cpp
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      This file implements the IRVTabulator class as outlined in
+ *                   `irv_tabulator.h`.
+ *****************************************************************************/
+#include "irv_tabulator.h"
+
+const std::vector<unsigned> &IRVTabulator::tabulate(
+    const IRVBallotGroups &fixed,
+    const std::vector<IRVBallotCount> &ballotcounts, PRNG *engine,
+    unsigned nWinners) {
+  // Reset the scratch space. None of these reallocate once they have grown.
+  entries.clear();
+  heads.assign(nCandidates, endOfGroup);
+  tallies.assign(fixed.tallies.begin(), fixed.tallies.end());
+  eliminated.assign((nCandidates + 63) / 64, 0);
+  eliminationOrder.clear();
+  roundTallies.clear();
+
+  // Tally the initial first preferences for each additional ballot. Empty
+  // ballots are skipped, as these are useless to the social choice function.
+  for (const IRVBallotCount &bc : ballotcounts) push(&bc, 0);
+
+  // While the winners are undetermined.
+  for (unsigned nStanding = nCandidates; nStanding > 1; --nStanding) {
+    // Determine candidates with the minimum tally, and the continuing tally.
+    unsigned minTally = std::numeric_limits<unsigned>::max();
+    uint64_t total = 0;
+    for (unsigned i = 0; i < nCandidates; ++i) {
+      if (!isEliminated(i) && tallies[i] <= minTally) {
+        if (tallies[i] < minTally) {
+          tiedMin.clear();
+          minTally = tallies[i];
+        }
+        tiedMin.push_back(i);
+      }
+      if (!isEliminated(i)) total += tallies[i];
+    }
+
+    // Record the tallies at the start of the round.
+    if (recordTallies)
+      roundTallies.insert(roundTallies.end(), tallies.begin(), tallies.end());
+
+    // Stop once the winners are determined.
+    if (nWinners > 0) {
+      if (nStanding <= nWinners) break;
+      unsigned nCertain = 0;
+      for (unsigned i = 0; i < nCandidates; ++i) {
+        if (!isEliminated(i) &&
+            uint64_t{tallies[i]} * (nWinners + 1) > total)
+          ++nCertain;
+      }
+      if (nCertain == nWinners) break;
+    }
+
+    // Tie-break by choosing at random from the tied candidates.
+    std::uniform_int_distribution<> randInt(0, tiedMin.size() - 1);
+    unsigned elim = tiedMin[randInt(*engine)];
+
+    // Eliminate the standing candidate with the minimum tally.
+    eliminated[elim >> 6] |= uint64_t{1} << (elim & 63);
+    eliminationOrder.push_back(elim);
+
+    // Redistribute the fixed ballots with the losing candidate as their first
+    // preference, followed by the remaining ballots attributed to them.
+    for (size_t i = fixed.offsets[elim]; i < fixed.offsets[elim + 1]; ++i) {
+      push(&fixed.ballots[i], 1);
+    }
+    for (unsigned e = heads[elim]; e != endOfGroup; e = entries[e].next) {
+      push(entries[e].bc, entries[e].cursor + 1);
+    }
+  }
+
+  // Append the standing candidates in ascending order of tally. Any certain
+  // winners hold a larger tally than every other standing candidate.
+  standing.clear();
+  for (unsigned i = 0; i < nCandidates; ++i) {
+    if (!isEliminated(i)) standing.push_back(i);
+  }
+  std::stable_sort(
+      standing.begin(), standing.end(),
+      [&](unsigned a, unsigned b) { return tallies[a] < tallies[b]; });
+  eliminationOrder.insert(eliminationOrder.end(), standing.begin(),
+                          standing.end());
+
+  return eliminationOrder;
+}
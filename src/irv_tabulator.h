@@ -0,0 +1,148 @@
+/******************************************************************************
+ * File:             irv_tabulator.h
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      This file declares the IRVTabulator, which evaluates the
+ *                   IRV social choice function without modifying the ballots.
+ *                   The tabulator owns all of its' scratch space, so that
+ *                   evaluating many elections with the same tabulator does
+ *                   not allocate once the scratch space has grown.
+ *****************************************************************************/
+#ifndef IRV_TABULATOR_H
+#define IRV_TABULATOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "irv_ballot.h"
+
+class IRVTabulator {
+ private:
+  // Marks the end of a tally group.
+  static constexpr unsigned endOfGroup = std::numeric_limits<unsigned>::max();
+
+  // A ballot in a candidate's tally group, along with the position of its'
+  // current preference.
+  struct Entry {
+    const IRVBallotCount *bc;
+    unsigned cursor;
+    // The index of the next entry in the same tally group.
+    unsigned next;
+  };
+
+  // The number of candidates in the election.
+  unsigned nCandidates;
+
+  // Every tally group is a singly linked list of entries in this array.
+  std::vector<Entry> entries{};
+
+  // The index of the first entry in each candidate's tally group.
+  std::vector<unsigned> heads{};
+
+  // The tally for each candidate.
+  std::vector<unsigned> tallies{};
+
+  // A bitmask of the eliminated candidates.
+  std::vector<uint64_t> eliminated{};
+
+  // The standing candidates tied on the minimum tally.
+  std::vector<unsigned> tiedMin{};
+
+  // The standing candidates when tabulation stops.
+  std::vector<unsigned> standing{};
+
+  // The candidate indices in order of elimination.
+  std::vector<unsigned> eliminationOrder{};
+
+  // Whether to record the tallies at the start of each round.
+  bool recordTallies = false;
+
+  // The tally of every candidate at the start of each round, one round after
+  // another. The entries of eliminated candidates are unspecified.
+  std::vector<unsigned> roundTallies{};
+
+  /*! \brief Checks whether a candidate has been eliminated.
+   */
+  bool isEliminated(unsigned c) const {
+    return (eliminated[c >> 6] >> (c & 63)) & 1;
+  }
+
+  /*! \brief Adds a ballot to the tally of its' next standing preference.
+   *
+   * \param bc The ballot count to add.
+   *
+   * \param cursor The position in the ballot from which to search for a
+   * standing preference. If none is found, the ballot is exhausted and is not
+   * added to any tally.
+   */
+  void push(const IRVBallotCount *bc, unsigned cursor) {
+    unsigned n = bc->first.nPreferences();
+    while (cursor < n && isEliminated(bc->first[cursor])) ++cursor;
+    if (cursor == n) return;
+    unsigned c = bc->first[cursor];
+    entries.push_back({bc, cursor, heads[c]});
+    heads[c] = entries.size() - 1;
+    tallies[c] += bc->second;
+  }
+
+ public:
+  /*! \brief Constructs a tabulator for elections with a fixed number of
+   * candidates.
+   *
+   * \param nCandidates_ The number of candidates in each election.
+   */
+  IRVTabulator(unsigned nCandidates_) : nCandidates(nCandidates_) {}
+
+  /*! \brief Sets whether to record the tallies at the start of each round.
+   *
+   * \param record Whether to record the tallies.
+   */
+  void setRecordTallies(bool record) { recordTallies = record; }
+
+  /*! \brief Gets the tallies recorded during the last tabulation.
+   *
+   * \return The tally of every candidate at the start of each round, with
+   * `nCandidates` entries per round. The entries of candidates eliminated in
+   * an earlier round are unspecified. Empty unless tallies are being
+   * recorded.
+   */
+  const std::vector<unsigned> &getRoundTallies() const { return roundTallies; }
+
+  /*! \brief Evaluates the outcome of an IRV election.
+   *
+   *  The election consists of a fixed set of grouped ballots along with some
+   * additional ballots, neither of which are modified. The fixed ballots are
+   * only visited when their current preference is eliminated.
+   *
+   *  When only the winners are required, tabulation stops as soon as they
+   * are determined: either when `nWinners` candidates remain, or when each of
+   * `nWinners` standing candidates holds more than 1 / (nWinners + 1) of the
+   * continuing tally. Such a candidate can never hold the minimum tally while
+   * more than `nWinners` candidates stand, so it is certain to win. With one
+   * winner this is the usual majority rule.
+   *
+   * \param fixed The grouped ballots common to many elections.
+   *
+   * \param ballotcounts The additional ballot counts for this election.
+   *
+   * \param engine A pointer to a PRNG for tie-breaking.
+   *
+   * \param nWinners The number of winners required, or zero to compute the
+   * complete elimination order.
+   *
+   * \return A reference to the candidate indices in order of elimination,
+   * which remains valid until the next call. When tabulation stops early, the
+   * candidates still standing follow the eliminated candidates in ascending
+   * order of tally, so the winners are always the final `nWinners` entries.
+   */
+  const std::vector<unsigned> &tabulate(
+      const IRVBallotGroups &fixed,
+      const std::vector<IRVBallotCount> &ballotcounts, PRNG *engine,
+      unsigned nWinners = 0);
+};
+
+#endif /* IRV_TABULATOR_H */
@@ -0,0 +1,145 @@
+/******************************************************************************
+ * File:             outcome_table.h
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      This file implements an open-addressing hash table which
+ *                   counts occurrences of outcomes. The (outcome, count) pairs
+ *                   are stored contiguously in insertion order, so the whole
+ *                   table can be copied out without traversing the index.
+ *****************************************************************************/
+
+#ifndef OUTCOME_TABLE_H
+#define OUTCOME_TABLE_H
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <vector>
+
+template <typename Outcome>
+class OutcomeTable {
+ private:
+  // Marks an unoccupied slot in the index.
+  static constexpr unsigned emptySlot = std::numeric_limits<unsigned>::max();
+
+  // The (outcome, count) pairs, in order of first insertion.
+  std::vector<std::pair<Outcome, unsigned>> entries{};
+
+  // The hash of each entry, so that probing and rehashing do not need to
+  // rehash the outcomes.
+  std::vector<size_t> hashes{};
+
+  // The open-addressing index. Each slot holds an index into `entries`, or
+  // `emptySlot`. Its' size is always zero or a power of two.
+  std::vector<unsigned> slots{};
+
+  /*! \brief Finds the slot for an outcome using linear probing.
+   *
+   * \param o The outcome to search for.
+   *
+   * \param h The hash of the outcome.
+   *
+   * \return The index of the slot containing the outcome, or of the empty
+   * slot where it would be inserted.
+   */
+  size_t findSlot(const Outcome &o, size_t h) const {
+    size_t mask = slots.size() - 1;
+    size_t i = h & mask;
+    while (slots[i] != emptySlot) {
+      unsigned e = slots[i];
+      if (hashes[e] == h && entries[e].first == o) break;
+      i = (i + 1) & mask;
+    }
+    return i;
+  }
+
+  /*! \brief Doubles the size of the index and reinserts every entry.
+   */
+  void grow() {
+    slots.assign(slots.empty() ? 16 : slots.size() * 2, emptySlot);
+    size_t mask = slots.size() - 1;
+    for (unsigned e = 0; e < entries.size(); ++e) {
+      size_t i = hashes[e] & mask;
+      while (slots[i] != emptySlot) i = (i + 1) & mask;
+      slots[i] = e;
+    }
+  }
+
+ public:
+  /*! \brief Adds count occurrences of an outcome to the table.
+   *
+   * \param o The outcome to add.
+   *
+   * \param count The number of occurrences.
+   */
+  void add(const Outcome &o, unsigned count) {
+    // Keep the load factor at most one half.
+    if (2 * (entries.size() + 1) > slots.size()) grow();
+    size_t h = std::hash<Outcome>{}(o);
+    size_t i = findSlot(o, h);
+    if (slots[i] == emptySlot) {
+      slots[i] = entries.size();
+      entries.emplace_back(o, count);
+      hashes.push_back(h);
+    } else {
+      entries[slots[i]].second += count;
+    }
+  }
+
+  /*! \brief Returns the number of times an outcome has been added.
+   *
+   * \param o The outcome to search for.
+   *
+   * \return The total count of the outcome, or zero if it is not present.
+   */
+  unsigned count(const Outcome &o) const {
+    if (slots.empty()) return 0;
+    size_t i = findSlot(o, std::hash<Outcome>{}(o));
+    return slots[i] == emptySlot ? 0 : entries[slots[i]].second;
+  }
+
+  /*! \brief Removes every outcome, retaining allocated storage.
+   */
+  void clear() {
+    entries.clear();
+    hashes.clear();
+    std::fill(slots.begin(), slots.end(), emptySlot);
+  }
+
+  /*! \brief Returns the number of distinct outcomes in the table.
+   */
+  size_t size() const { return entries.size(); }
+
+  /*! \brief Returns whether the table is empty.
+   */
+  bool empty() const { return entries.empty(); }
+
+  /*! \brief Gets the contiguous (outcome, count) pairs.
+   *
+   * \return A reference to the pairs in order of first insertion.
+   */
+  const std::vector<std::pair<Outcome, unsigned>> &data() const {
+    return entries;
+  }
+
+  /*! \brief Moves the (outcome, count) pairs out of the table, leaving it
+   * empty.
+   *
+   * \return The pairs in order of first insertion.
+   */
+  std::vector<std::pair<Outcome, unsigned>> release() {
+    std::vector<std::pair<Outcome, unsigned>> out = std::move(entries);
+    entries = {};
+    hashes.clear();
+    slots.clear();
+    return out;
+  }
+
+  // Iteration over the (outcome, count) pairs.
+  auto begin() const { return entries.begin(); }
+  auto end() const { return entries.end(); }
+};
+
+#endif /* OUTCOME_TABLE_H */
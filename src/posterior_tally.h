@@ -0,0 +1,209 @@
+/******************************************************************************
+ * File:             posterior_tally.h
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      This file implements the PosteriorTally, which
+ *                   accumulates the results of simulated elections. Each
+ *                   worker thread keeps its' own tally, and the tallies are
+ *                   merged once sampling is complete, so memory use does not
+ *                   grow with the number of elections simulated unless the
+ *                   full elimination orders are recorded.
+ *****************************************************************************/
+
+#ifndef POSTERIOR_TALLY_H
+#define POSTERIOR_TALLY_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "irv_ballot.h"
+#include "outcome_table.h"
+
+class PosteriorTally {
+ private:
+  // The number of candidates in each election.
+  unsigned nCandidates;
+
+  // The number of candidates elected in each election.
+  unsigned nWinners;
+
+  // Whether to record a histogram of the elimination orders.
+  bool keepOrders;
+
+  // The number of elections tallied.
+  uint64_t nElections = 0;
+
+  // The number of elections won by each candidate.
+  std::vector<uint64_t> wins{};
+
+  // The number of times each elimination order occurred. An elimination order
+  // is a permutation of the candidates, so it is stored compactly as an
+  // IRVBallot listing the candidates in order of elimination.
+  OutcomeTable<IRVBallot> orders{};
+
+  // The number of elections in which candidate a was eliminated before
+  // candidate b, at index a * nCandidates + b. Recorded along with the orders.
+  std::vector<uint64_t> precedence{};
+
+  // The number of bins in each tally histogram, and the range of tallies
+  // covered by each bin. Zero bins means the tallies are not recorded.
+  unsigned nBins = 0;
+  unsigned binWidth = 1;
+
+  // A histogram of the tallies of each standing candidate at the start of each
+  // round, at index (round * nCandidates + candidate) * nBins + bin.
+  std::vector<uint64_t> tallyBins{};
+
+  // The maximum number of bins across all of the tally histograms, which
+  // bounds their memory use for large contests.
+  static constexpr size_t maxTotalBins = size_t{1} << 20;
+
+ public:
+  /*! \brief Constructs an empty tally.
+   *
+   * \param nCandidates_ The number of candidates in each election.
+   *
+   * \param nWinners_ The number of candidates elected in each election.
+   *
+   * \param keepOrders_ Whether to record a histogram of the elimination
+   * orders, and how often each candidate is eliminated before each other.
+   * The elimination orders added must then be complete.
+   *
+   * \param maxTally The largest possible tally, or zero to skip recording the
+   * distribution of tallies in each round. Tallies are binned exactly when
+   * there are few enough of them, and in equal-width bins otherwise.
+   */
+  PosteriorTally(unsigned nCandidates_, unsigned nWinners_,
+                 bool keepOrders_ = false, unsigned maxTally = 0)
+      : nCandidates(nCandidates_),
+        nWinners(nWinners_),
+        keepOrders(keepOrders_),
+        wins(nCandidates_, 0) {
+    if (keepOrders) precedence.assign(nCandidates * nCandidates, 0);
+    if (maxTally > 0 && nCandidates > 1) {
+      size_t nHistograms = size_t{nCandidates - 1} * nCandidates;
+      size_t limit = std::max<size_t>(maxTotalBins / nHistograms, 1);
+      nBins = std::min<size_t>(size_t{maxTally} + 1, limit);
+      binWidth = maxTally / nBins + 1;
+      tallyBins.assign(nHistograms * nBins, 0);
+    }
+  }
+
+  /*! \brief Adds the result of an election to the tally.
+   *
+   * \param eliminationOrder The candidates in order of elimination, ending
+   * with the winners.
+   *
+   * \param roundTallies The tally of every candidate at the start of each
+   * round, as recorded by `IRVTabulator`. Required only when the distribution
+   * of tallies is being recorded.
+   */
+  void add(const std::vector<unsigned> &eliminationOrder,
+           const std::vector<unsigned> *roundTallies = nullptr) {
+    for (unsigned k = nCandidates - nWinners; k < nCandidates; ++k)
+      ++wins[eliminationOrder[k]];
+    if (keepOrders) {
+      orders.add(IRVBallot(eliminationOrder), 1);
+      for (unsigned i = 0; i < nCandidates; ++i) {
+        for (unsigned j = i + 1; j < nCandidates; ++j)
+          ++precedence[eliminationOrder[i] * nCandidates + eliminationOrder[j]];
+      }
+    }
+    if (nBins > 0 && roundTallies) {
+      unsigned nRounds = roundTallies->size() / nCandidates;
+      for (unsigned r = 0; r < nRounds; ++r) {
+        // The candidates standing in round r are those not yet eliminated.
+        for (unsigned k = r; k < nCandidates; ++k) {
+          unsigned c = eliminationOrder[k];
+          unsigned bin = (*roundTallies)[r * nCandidates + c] / binWidth;
+          ++tallyBins[(size_t{r} * nCandidates + c) * nBins + bin];
+        }
+      }
+    }
+    ++nElections;
+  }
+
+  /*! \brief Adds the elections of another tally to this one.
+   *
+   * \param other A tally of elections with the same candidates, winners and
+   * recorded statistics.
+   */
+  void merge(const PosteriorTally &other) {
+    for (unsigned c = 0; c < nCandidates; ++c) wins[c] += other.wins[c];
+    for (const auto &[order, count] : other.orders) orders.add(order, count);
+    for (size_t i = 0; i < precedence.size(); ++i)
+      precedence[i] += other.precedence[i];
+    for (size_t i = 0; i < tallyBins.size(); ++i)
+      tallyBins[i] += other.tallyBins[i];
+    nElections += other.nElections;
+  }
+
+  /*! \brief Removes every election from the tally, retaining allocated
+   * storage.
+   */
+  void clear() {
+    std::fill(wins.begin(), wins.end(), 0);
+    orders.clear();
+    std::fill(precedence.begin(), precedence.end(), 0);
+    std::fill(tallyBins.begin(), tallyBins.end(), 0);
+    nElections = 0;
+  }
+
+  /*! \brief Gets the number of elections tallied.
+   */
+  uint64_t getNElections() const { return nElections; }
+
+  /*! \brief Gets the number of elections won by each candidate.
+   */
+  const std::vector<uint64_t> &getWins() const { return wins; }
+
+  /*! \brief Gets the histogram of elimination orders, which is empty unless
+   * the orders are being recorded.
+   */
+  const OutcomeTable<IRVBallot> &getOrders() const { return orders; }
+
+  /*! \brief Gets how often each candidate was eliminated before each other.
+   *
+   * \return The number of elections in which candidate a was eliminated
+   * before candidate b, at index a * nCandidates + b. Empty unless the orders
+   * are being recorded.
+   */
+  const std::vector<uint64_t> &getPrecedence() const { return precedence; }
+
+  /*! \brief Computes a quantile of a candidate's tally in a round.
+   *
+   *  Only elections in which the candidate is standing at the start of the
+   * round contribute. The quantile is the smallest tally t such that a
+   * proportion of at least p of the tallies are no greater than t. When the
+   * tallies are binned, the lower bound of the bin containing t is returned.
+   *
+   * \param round The round, where the first preferences are tallied in round
+   * zero.
+   *
+   * \param candidate The candidate index.
+   *
+   * \param p The probability of the quantile.
+   *
+   * \return The quantile, or NaN if the candidate never stood in the round.
+   */
+  double tallyQuantile(unsigned round, unsigned candidate, double p) const {
+    const uint64_t *bins =
+        &tallyBins[(size_t{round} * nCandidates + candidate) * nBins];
+    uint64_t n = 0;
+    for (unsigned b = 0; b < nBins; ++b) n += bins[b];
+    if (n == 0) return std::numeric_limits<double>::quiet_NaN();
+    double target = std::max(p * n, 1.);
+    uint64_t cumulative = 0;
+    for (unsigned b = 0; b < nBins; ++b) {
+      cumulative += bins[b];
+      if (cumulative >= target) return static_cast<double>(b) * binWidth;
+    }
+    return static_cast<double>(nBins - 1) * binWidth;
+  }
+};
+
+#endif /* POSTERIOR_TALLY_H */
@@ -0,0 +1,218 @@
+/******************************************************************************
+ * File:             prng.cpp
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      This file implements the generators as outlined in
+ *                   `prng.h`.
+ *****************************************************************************/
+#include "prng.h"
+
+// Advances a SplitMix64 state and returns the next output. Used to expand
+// small seeds into the state of a larger generator.
+static uint64_t splitMix64(uint64_t &x) {
+  uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Presents the outputs of a Philox4x32 stream as a seed sequence, so that an
+// engine can fill its' state directly from the stream.
+struct PhiloxSeedSeq {
+  typedef uint32_t result_type;
+
+  Philox4x32 &philox;
+
+  template <class It>
+  void generate(It begin, It end) {
+    uint32_t out[4];
+    unsigned pos = 4;
+    for (; begin != end; ++begin) {
+      if (pos == 4) {
+        philox.generate(out);
+        pos = 0;
+      }
+      *begin = out[pos++];
+    }
+  }
+};
+
+// Draws 64-bit words from a Philox4x32 stream.
+static void generateWords(Philox4x32 &philox, uint64_t *out) {
+  uint32_t words[8];
+  philox.generate(words);
+  philox.generate(words + 4);
+  for (unsigned i = 0; i < 4; ++i)
+    out[i] = (uint64_t{words[2 * i]} << 32) | words[2 * i + 1];
+}
+
+// Draws 64-bit words from a seed sequence.
+static void generateWords(std::seed_seq &ss, uint64_t *out, unsigned n) {
+  uint32_t words[8];
+  ss.generate(words, words + 2 * n);
+  for (unsigned i = 0; i < n; ++i)
+    out[i] = (uint64_t{words[2 * i]} << 32) | words[2 * i + 1];
+}
+
+void Xoshiro256pp::seed(uint64_t seed_) {
+  for (uint64_t &x : s) x = splitMix64(seed_);
+}
+
+void Xoshiro256pp::seed(std::seed_seq &ss) {
+  uint64_t words[4];
+  generateWords(ss, words, 4);
+  seedWords(words);
+}
+
+void Xoshiro256pp::seedWords(const uint64_t *words) {
+  for (unsigned i = 0; i < 4; ++i) s[i] = words[i];
+  // The all-zero state is a fixed point.
+  if ((s[0] | s[1] | s[2] | s[3]) == 0) s[0] = 1;
+}
+
+void PCG64::seedWords(const uint64_t *words) {
+  // The canonical PCG seeding procedure, with the stream (words[2], words[3])
+  // shifted left into an odd increment.
+  stateHi = stateLo = 0;
+  incHi = (words[2] << 1) | (words[3] >> 63);
+  incLo = (words[3] << 1) | 1;
+  step();
+  add(words[0], words[1]);
+  step();
+}
+
+void PCG64::seed(uint64_t seed_) {
+  uint64_t words[4];
+  for (uint64_t &x : words) x = splitMix64(seed_);
+  seedWords(words);
+}
+
+void PCG64::seed(std::seed_seq &ss) {
+  uint64_t words[4];
+  generateWords(ss, words, 4);
+  seedWords(words);
+}
+
+void PRNG::seed(result_type seed_) {
+  pos = blockSize;
+  switch (getKind()) {
+    case Kind::MT19937: {
+      std::mt19937 &mt = *std::get<BoxedMT19937>(engine);
+      mt.seed(seed_);
+      mt.discard(mt.state_size * 100);
+      break;
+    }
+    case Kind::Xoshiro256pp:
+      std::get<Xoshiro256pp>(engine).seed(seed_);
+      break;
+    case Kind::PCG64:
+      std::get<PCG64>(engine).seed(seed_);
+      break;
+    case Kind::Philox4x32: {
+      uint64_t x = seed_;
+      std::get<Philox4x32>(engine).seed(splitMix64(x));
+      break;
+    }
+  }
+}
+
+void PRNG::seed(std::seed_seq &ss) {
+  pos = blockSize;
+  switch (getKind()) {
+    case Kind::MT19937:
+      (*std::get<BoxedMT19937>(engine)).seed(ss);
+      break;
+    case Kind::Xoshiro256pp:
+      std::get<Xoshiro256pp>(engine).seed(ss);
+      break;
+    case Kind::PCG64:
+      std::get<PCG64>(engine).seed(ss);
+      break;
+    case Kind::Philox4x32: {
+      uint64_t key;
+      generateWords(ss, &key, 1);
+      std::get<Philox4x32>(engine).seed(key);
+      break;
+    }
+  }
+}
+
+void PRNG::seedStream(uint64_t seed_, uint64_t stream) {
+  pos = blockSize;
+  Philox4x32 source;
+  source.seed(seed_, stream);
+  uint64_t words[4];
+  switch (getKind()) {
+    case Kind::MT19937: {
+      PhiloxSeedSeq ss{source};
+      (*std::get<BoxedMT19937>(engine)).seed(ss);
+      break;
+    }
+    case Kind::Xoshiro256pp:
+      generateWords(source, words);
+      std::get<Xoshiro256pp>(engine).seedWords(words);
+      break;
+    case Kind::PCG64:
+      generateWords(source, words);
+      std::get<PCG64>(engine).seedWords(words);
+      break;
+    case Kind::Philox4x32:
+      engine = source;
+      break;
+  }
+}
+
+void PRNG::refill() {
+  // Each engine is fetched once per block, so the choice of engine costs one
+  // branch per block.
+  switch (getKind()) {
+    case Kind::MT19937: {
+      std::mt19937 &mt = *std::get<BoxedMT19937>(engine);
+      for (unsigned i = 0; i < blockSize; ++i) block[i] = mt();
+      break;
+    }
+    case Kind::Xoshiro256pp: {
+      Xoshiro256pp &xoshiro = std::get<Xoshiro256pp>(engine);
+      // Each 64-bit output provides two 32-bit outputs.
+      for (unsigned i = 0; i < blockSize; i += 2) {
+        uint64_t x = xoshiro();
+        block[i] = static_cast<uint32_t>(x);
+        block[i + 1] = static_cast<uint32_t>(x >> 32);
+      }
+      break;
+    }
+    case Kind::PCG64: {
+      PCG64 &pcg = std::get<PCG64>(engine);
+      for (unsigned i = 0; i < blockSize; i += 2) {
+        uint64_t x = pcg();
+        block[i] = static_cast<uint32_t>(x);
+        block[i + 1] = static_cast<uint32_t>(x >> 32);
+      }
+      break;
+    }
+    case Kind::Philox4x32: {
+      Philox4x32 &philox = std::get<Philox4x32>(engine);
+      for (unsigned i = 0; i < blockSize; i += 4) philox.generate(block + i);
+      break;
+    }
+  }
+  pos = 0;
+}
+
+void PRNG::select(Kind kind_) {
+  switch (kind_) {
+    case Kind::MT19937:
+      engine.emplace<BoxedMT19937>();
+      break;
+    case Kind::Xoshiro256pp:
+      engine.emplace<Xoshiro256pp>();
+      break;
+    case Kind::PCG64:
+      engine.emplace<PCG64>();
+      break;
+    case Kind::Philox4x32:
+      engine.emplace<Philox4x32>();
+      break;
+  }
+}
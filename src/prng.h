@@ -0,0 +1,370 @@
+/******************************************************************************
+ * File:             prng.h
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      This file declares the pseudo-random number generators
+ *                   available for sampling, along with `PRNG`, which selects
+ *                   one of them at runtime. `PRNG` serves 32-bit outputs from
+ *                   a small buffer which is refilled in blocks, so that the
+ *                   choice of generator costs one branch per block rather
+ *                   than one per draw.
+ *****************************************************************************/
+#ifndef PRNG_H
+#define PRNG_H
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <random>
+#include <variant>
+
+/*! \brief The xoshiro256++ generator of Blackman and Vigna (2019).
+ *
+ *  A fast generator with 256 bits of state, satisfying the
+ * UniformRandomBitGenerator requirements.
+ */
+class Xoshiro256pp {
+ private:
+  uint64_t s[4];
+
+  static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+ public:
+  typedef uint64_t result_type;
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  Xoshiro256pp(uint64_t seed_ = 0) { seed(seed_); }
+
+  /*! \brief Seeds the generator by expanding a 64-bit seed with SplitMix64.
+   *
+   * \param seed_ The seed.
+   */
+  void seed(uint64_t seed_);
+
+  /*! \brief Seeds the generator from a seed sequence.
+   *
+   * \param ss The seed sequence.
+   */
+  void seed(std::seed_seq &ss);
+
+  /*! \brief Seeds the generator from four 64-bit words.
+   *
+   * \param words The words of the state.
+   */
+  void seedWords(const uint64_t *words);
+
+  result_type operator()() {
+    uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+  }
+};
+
+/*! \brief The PCG64 (XSL-RR 128/64) generator of O'Neill (2014).
+ *
+ *  A 128-bit linear congruential generator with a permuted 64-bit output,
+ * satisfying the UniformRandomBitGenerator requirements. The 128-bit state is
+ * held as two 64-bit words, so that no compiler extension is required.
+ */
+class PCG64 {
+ private:
+  uint64_t stateHi = 0, stateLo = 0;
+  uint64_t incHi = 0, incLo = 1;
+
+  /*! \brief Computes the full 128-bit product of two 64-bit words.
+   */
+  static void mulhilo(uint64_t a, uint64_t b, uint64_t &hi, uint64_t &lo) {
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 uint128;
+    uint128 product = static_cast<uint128>(a) * b;
+    hi = static_cast<uint64_t>(product >> 64);
+    lo = static_cast<uint64_t>(product);
+#else
+    // Multiply the 32-bit halves, and carry the middle terms into the upper
+    // word.
+    uint64_t aLo = a & 0xFFFFFFFF, aHi = a >> 32;
+    uint64_t bLo = b & 0xFFFFFFFF, bHi = b >> 32;
+    uint64_t ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+    uint64_t mid = (ll >> 32) + (lh & 0xFFFFFFFF) + (hl & 0xFFFFFFFF);
+    hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+    lo = (mid << 32) | (ll & 0xFFFFFFFF);
+#endif
+  }
+
+  /*! \brief Adds a 128-bit value to the state, modulo 2^128.
+   */
+  void add(uint64_t hi, uint64_t lo) {
+    stateLo += lo;
+    stateHi += hi + (stateLo < lo);
+  }
+
+  void step() {
+    const uint64_t multHi = 0x2360ED051FC65DA4ULL;
+    const uint64_t multLo = 0x4385DF649FCCF645ULL;
+    uint64_t hi, lo;
+    mulhilo(stateLo, multLo, hi, lo);
+    stateHi = hi + stateHi * multLo + stateLo * multHi;
+    stateLo = lo;
+    add(incHi, incLo);
+  }
+
+ public:
+  typedef uint64_t result_type;
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  PCG64(uint64_t seed_ = 0) { seed(seed_); }
+
+  /*! \brief Seeds the generator by expanding a 64-bit seed with SplitMix64.
+   *
+   * \param seed_ The seed.
+   */
+  void seed(uint64_t seed_);
+
+  /*! \brief Seeds the generator from a seed sequence.
+   *
+   * \param ss The seed sequence.
+   */
+  void seed(std::seed_seq &ss);
+
+  /*! \brief Seeds the state and stream from four 64-bit words.
+   *
+   * \param words The initial state and stream, as two words each.
+   */
+  void seedWords(const uint64_t *words);
+
+  result_type operator()() {
+    step();
+    uint64_t x = stateHi ^ stateLo;
+    unsigned rot = static_cast<unsigned>(stateHi >> 58);
+    return (x >> rot) | (x << ((64 - rot) & 63));
+  }
+};
+
+/*! \brief The Philox4x32-10 counter-based generator of Salmon et al. (2011).
+ *
+ *  Each block of four outputs is a keyed bijection of a 128-bit counter, so
+ * any position in any stream can be reached in constant time. The key selects
+ * the seed and the upper half of the counter selects the stream, giving 2^64
+ * independent streams of 2^66 outputs for each seed.
+ */
+class Philox4x32 {
+ private:
+  uint32_t key[2] = {0, 0};
+  uint32_t counter[4] = {0, 0, 0, 0};
+
+  static void mulhilo(uint32_t a, uint32_t b, uint32_t &hi, uint32_t &lo) {
+    uint64_t product = uint64_t{a} * b;
+    hi = static_cast<uint32_t>(product >> 32);
+    lo = static_cast<uint32_t>(product);
+  }
+
+ public:
+  typedef uint32_t result_type;
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  /*! \brief Positions the generator at the start of a stream.
+   *
+   * \param seed_ The key of the generator.
+   *
+   * \param stream The index of the stream.
+   */
+  void seed(uint64_t seed_, uint64_t stream = 0) {
+    key[0] = static_cast<uint32_t>(seed_);
+    key[1] = static_cast<uint32_t>(seed_ >> 32);
+    counter[0] = counter[1] = 0;
+    counter[2] = static_cast<uint32_t>(stream);
+    counter[3] = static_cast<uint32_t>(stream >> 32);
+  }
+
+  /*! \brief Generates the next block of four outputs.
+   *
+   * \param out The array to write the outputs to.
+   */
+  void generate(uint32_t *out) {
+    uint32_t c[4] = {counter[0], counter[1], counter[2], counter[3]};
+    uint32_t k[2] = {key[0], key[1]};
+    for (unsigned round = 0; round < 10; ++round) {
+      uint32_t hi0, lo0, hi1, lo1;
+      mulhilo(0xD2511F53u, c[0], hi0, lo0);
+      mulhilo(0xCD9E8D57u, c[2], hi1, lo1);
+      c[0] = hi1 ^ c[1] ^ k[0];
+      c[1] = lo1;
+      c[2] = hi0 ^ c[3] ^ k[1];
+      c[3] = lo0;
+      k[0] += 0x9E3779B9u;
+      k[1] += 0xBB67AE85u;
+    }
+    for (unsigned i = 0; i < 4; ++i) out[i] = c[i];
+    // Advance the lower half of the counter, which is the position within
+    // the stream selected by the upper half.
+    if (++counter[0] == 0) ++counter[1];
+  }
+};
+
+/*! \brief A Mersenne Twister held out of line.
+ *
+ *  The state of a Mersenne Twister is 5000 bytes, so it is kept on the heap
+ * rather than sizing every `PRNG` to fit it. Copies are deep.
+ */
+class BoxedMT19937 {
+ private:
+  std::unique_ptr<std::mt19937> mt;
+
+ public:
+  BoxedMT19937() : mt(new std::mt19937()) {}
+  BoxedMT19937(const BoxedMT19937 &other) : mt(new std::mt19937(*other)) {}
+  BoxedMT19937(BoxedMT19937 &&other) = default;
+  BoxedMT19937 &operator=(const BoxedMT19937 &other) {
+    mt.reset(new std::mt19937(*other));
+    return *this;
+  }
+  BoxedMT19937 &operator=(BoxedMT19937 &&other) = default;
+
+  std::mt19937 &operator*() const { return *mt; }
+};
+
+/*! \brief A 32-bit generator backed by one of several engines.
+ *
+ *  Satisfies the UniformRandomBitGenerator requirements, so it can be used
+ * with the standard library distributions. The engine is chosen at
+ * construction, and the same seed always gives the same stream for a given
+ * engine.
+ */
+class PRNG {
+ public:
+  // The available engines.
+  enum class Kind { MT19937, Xoshiro256pp, PCG64, Philox4x32 };
+
+  typedef uint32_t result_type;
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  // The seed used when none is given.
+  static constexpr result_type default_seed = std::mt19937::default_seed;
+
+ private:
+  // The number of outputs generated per refill.
+  static constexpr unsigned blockSize = 64;
+
+  // The engine in use. The alternatives are in the order of `Kind`, so the
+  // index of the alternative held is the kind of the engine.
+  std::variant<BoxedMT19937, Xoshiro256pp, PCG64, Philox4x32> engine;
+
+  // Buffered outputs, and the position of the next output to return.
+  result_type block[blockSize];
+  unsigned pos = blockSize;
+
+  /*! \brief Refills the buffer from the selected engine.
+   */
+  void refill();
+
+  /*! \brief Replaces the engine with an unseeded engine of the given kind.
+   */
+  void select(Kind kind_);
+
+ public:
+  /*! \brief Constructs a seeded generator.
+   *
+   * \param seed_ The seed.
+   *
+   * \param kind_ The engine to use.
+   */
+  PRNG(result_type seed_ = default_seed, Kind kind_ = Kind::MT19937) {
+    select(kind_);
+    seed(seed_);
+  }
+
+  /*! \brief Constructs a generator seeded from a seed sequence.
+   *
+   * \param ss The seed sequence.
+   *
+   * \param kind_ The engine to use.
+   */
+  PRNG(std::seed_seq &ss, Kind kind_ = Kind::MT19937) {
+    select(kind_);
+    seed(ss);
+  }
+
+  /*! \brief Constructs a generator seeded with one of many streams for a
+   * seed, as by `seedStream`.
+   *
+   * \param seed_ The seed shared by every stream.
+   *
+   * \param stream The index of the stream.
+   *
+   * \param kind_ The engine to use.
+   */
+  PRNG(uint64_t seed_, uint64_t stream, Kind kind_) {
+    select(kind_);
+    seedStream(seed_, stream);
+  }
+
+  /*! \brief Seeds the generator from a single integer.
+   *
+   *  A Mersenne Twister seeded from 32 bits is poorly mixed, so it is warmed
+   * up by discarding `state_size * 100` outputs. The other engines expand the
+   * seed with SplitMix64 and need no warm-up.
+   *
+   * \param seed_ The seed.
+   */
+  void seed(result_type seed_);
+
+  /*! \brief Seeds the generator from a seed sequence.
+   *
+   * \param ss The seed sequence.
+   */
+  void seed(std::seed_seq &ss);
+
+  /*! \brief Seeds the generator with one of many streams for a seed.
+   *
+   *  Distinct (seed, stream) pairs give independent streams, so work can be
+   * divided into independently reproducible units. The stream is always
+   * selected with Philox4x32, and the other engines take their initial state
+   * from its' outputs. This avoids a seed sequence, which is slow to fill the
+   * large state of a Mersenne Twister.
+   *
+   * \param seed_ The seed shared by every stream.
+   *
+   * \param stream The index of the stream.
+   */
+  void seedStream(uint64_t seed_, uint64_t stream);
+
+  /*! \brief Gets the engine in use.
+   *
+   * \return The kind of the underlying engine.
+   */
+  Kind getKind() const { return static_cast<Kind>(engine.index()); }
+
+  /*! \brief Advances the generator.
+   *
+   * \param n The number of outputs to skip.
+   */
+  void discard(unsigned long long n) {
+    for (; n; --n) (*this)();
+  }
+
+  result_type operator()() {
+    if (pos == blockSize) refill();
+    return block[pos++];
+  }
+};
+
+#endif /* PRNG_H */
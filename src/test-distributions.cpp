@@ -12,7 +12,7 @@ context("Test Dirichlet-Multinomial samples sum to count.") {
   std::vector<unsigned> result;
   unsigned sum;
   std::vector<double> a;
-  std::mt19937 mte;
+  PRNG mte;
   mte.seed(time(NULL));
   // We draw each a parameter from gamma(2,2)
   std::gamma_distribution<double> g(2.0, 2.0);
@@ -43,7 +43,7 @@ context("Test Dirichlet-Multinomial samples sum to count.") {
 }
 
 context("Test dirichlet marginal distributions.") {
-  std::mt19937 mte;
+  PRNG mte;
   mte.seed(time(NULL));
 
   unsigned n = 100;
@@ -66,3 +66,79 @@ context("Test dirichlet marginal distributions.") {
                 0.9 * static_cast<double>(n_trials) / static_cast<double>(n));
   }
 }
+
+context("Test gamma sampler moments.") {
+  PRNG mte;
+  mte.seed(time(NULL));
+
+  unsigned n_trials = 100000;
+
+  // Both the a < 1 boost and the direct Marsaglia-Tsang method are covered.
+  std::vector<double> shapes{0.2, 1., 7.5};
+  bool means_close = true;
+  bool variances_close = true;
+
+  for (double a : shapes) {
+    GammaSampler g(a);
+    double sum = 0., sum_sq = 0.;
+    for (unsigned i = 0; i < n_trials; ++i) {
+      double x = g(&mte);
+      sum += x;
+      sum_sq += x * x;
+    }
+    double mean = sum / n_trials;
+    double var = sum_sq / n_trials - mean * mean;
+    // The mean and variance of a gamma(a, 1) variate are both a.
+    means_close = means_close && mean < 1.05 * a && mean > 0.95 * a;
+    variances_close = variances_close && var < 1.1 * a && var > 0.9 * a;
+  }
+
+  test_that("Gamma samples have mean approximately a.") {
+    expect_true(means_close);
+  }
+
+  test_that("Gamma samples have variance approximately a.") {
+    expect_true(variances_close);
+  }
+
+  test_that("A non-positive shape gives zero.") {
+    expect_true(rGamma(0., &mte) == 0.);
+  }
+}
+
+context("Test binomial sampler moments.") {
+  PRNG mte;
+  mte.seed(time(NULL));
+
+  unsigned n_trials = 100000;
+
+  // Both inversion (small n * p) and BTPE (large n * p) are covered, as is
+  // the reflection for p > 0.5.
+  std::vector<std::pair<unsigned, double>> params{
+      {20, 0.3}, {1000, 0.01}, {1000, 0.4}, {100000, 0.9}};
+  bool means_close = true;
+  bool in_range = true;
+
+  for (const auto &[n, p] : params) {
+    double sum = 0.;
+    for (unsigned i = 0; i < n_trials; ++i) {
+      unsigned x = rBinomial(n, p, &mte);
+      in_range = in_range && x <= n;
+      sum += x;
+    }
+    double mean = sum / n_trials;
+    means_close = means_close && mean < 1.02 * n * p && mean > 0.98 * n * p;
+  }
+
+  test_that("Binomial samples have mean approximately n * p.") {
+    expect_true(means_close);
+  }
+
+  test_that("Binomial samples never exceed n.") { expect_true(in_range); }
+
+  test_that("Degenerate probabilities are handled.") {
+    expect_true(rBinomial(10, 0., &mte) == 0);
+    expect_true(rBinomial(10, 1., &mte) == 10);
+    expect_true(rBinomial(0, 0.5, &mte) == 0);
+  }
+}
@@ -0,0 +1,130 @@
+/*
+ * This file tests the IRVBallot representation and IRV tabulation.
+ */
+
+#include <testthat.h>
+
+#include <vector>
+
+#include "irv_ballot.h"
+#include "irv_tabulator.h"
+
+context("Test packed and wide IRVBallot representations agree.") {
+  // A short ballot fits in the packed representation, while a ballot
+  // referencing a candidate index >= 256 must fall back to the heap.
+  std::vector<unsigned> shortPrefs{4, 2, 1};
+  std::vector<unsigned> widePrefs{4, 2, 1, 300};
+  std::vector<unsigned> longPrefs(40);
+  for (unsigned i = 0; i < 40; ++i) longPrefs[i] = 39 - i;
+
+  IRVBallot s(shortPrefs), w(widePrefs), l(longPrefs);
+
+  test_that("Preferences are recovered in order.") {
+    expect_true(s.nPreferences() == 3);
+    expect_true(s[0] == 4 && s[1] == 2 && s[2] == 1);
+    expect_true(w.nPreferences() == 4 && w[3] == 300);
+    expect_true(l.nPreferences() == 40 && l[0] == 39 && l[39] == 0);
+  }
+
+  test_that("Comparisons are consistent across representations.") {
+    expect_true(s < w);
+    expect_false(w < s);
+    expect_false(s == w);
+    IRVBallot wCopy = w;
+    expect_true(wCopy == w);
+    IRVBallot sMoved = std::move(wCopy);
+    expect_true(sMoved == w);
+  }
+
+  test_that("Eliminating first preferences shifts the ballot.") {
+    expect_false(w.eliminateFirstPref());
+    expect_true(w.firstPreference() == 2 && w[2] == 300);
+    expect_false(s.eliminateFirstPref());
+    expect_false(s.eliminateFirstPref());
+    expect_true(s.eliminateFirstPref());
+    expect_true(s.nPreferences() == 0);
+  }
+
+  test_that("Shortened wide ballots hash as if built directly.") {
+    // Both the long ballot and a ballot with a large index are shortened
+    // until their preferences fit inline.
+    IRVBallot shortened(longPrefs), large(widePrefs);
+    for (unsigned i = 0; i < 16; ++i) shortened.eliminateFirstPref();
+    large.eliminateFirstPref();
+    large.eliminateFirstPref();
+    large.eliminateFirstPref();
+    large.eliminateFirstPref();
+    IRVBallot direct(longPrefs.begin() + 16, longPrefs.end());
+    IRVBallot empty;
+    expect_true(shortened == direct);
+    expect_true(shortened.hash() == direct.hash());
+    expect_true(large == empty && large.hash() == empty.hash());
+    // A ballot which still references a large index stays wide.
+    IRVBallot stillWide(widePrefs);
+    stillWide.eliminateFirstPref();
+    IRVBallot stillWideDirect(widePrefs.begin() + 1, widePrefs.end());
+    expect_true(stillWide.hash() == stillWideDirect.hash());
+  }
+}
+
+context("Test IRV tabulation with fixed and additional ballots.") {
+  PRNG mte(1);
+
+  // Candidate 2 is eliminated first, and their ballots flow to candidate 1
+  // who then overtakes candidate 0.
+  std::vector<IRVBallotCount> all;
+  all.emplace_back(IRVBallot(std::vector<unsigned>{0}), 4);
+  all.emplace_back(IRVBallot(std::vector<unsigned>{1, 0}), 3);
+  all.emplace_back(IRVBallot(std::vector<unsigned>{2, 1}), 2);
+  all.emplace_back(IRVBallot(), 5);
+  std::vector<IRVBallotCount> fixedBallots{all[0], all[2]};
+  std::vector<IRVBallotCount> extraBallots{all[1], all[3]};
+  std::vector<unsigned> expected{2, 0, 1};
+
+  IRVBallotGroups fixed(fixedBallots, 3);
+  IRVTabulator tabulator(3);
+
+  test_that("The elimination order is correct.") {
+    expect_true(socialChoiceIRV(all, 3, &mte) == expected);
+  }
+
+  test_that("Splitting the ballots does not change the outcome.") {
+    expect_true(tabulator.tabulate(fixed, extraBallots, &mte) == expected);
+    // Reusing the tabulator gives the same result.
+    expect_true(tabulator.tabulate(fixed, extraBallots, &mte) == expected);
+  }
+
+  test_that("The ballots are not modified.") {
+    expect_true(all[2].first.nPreferences() == 2);
+    expect_true(extraBallots[0].first.firstPreference() == 1);
+  }
+}
+
+context("Test IRV tabulation stops once the winners are determined.") {
+  PRNG mte(1);
+
+  // Candidate 0 holds a majority from the outset.
+  std::vector<IRVBallotCount> ballots;
+  ballots.emplace_back(IRVBallot(std::vector<unsigned>{0}), 6);
+  ballots.emplace_back(IRVBallot(std::vector<unsigned>{1}), 3);
+  ballots.emplace_back(IRVBallot(std::vector<unsigned>{2}), 2);
+
+  IRVBallotGroups none(std::vector<IRVBallotCount>{}, 3);
+  IRVTabulator tabulator(3);
+
+  test_that("A majority determines a single winner immediately.") {
+    std::vector<unsigned> expected{2, 1, 0};
+    expect_true(tabulator.tabulate(none, ballots, &mte, 1) == expected);
+  }
+
+  test_that("Multiple winners are the final standing candidates.") {
+    std::vector<unsigned> order = tabulator.tabulate(none, ballots, &mte, 2);
+    expect_true(order.size() == 3);
+    expect_true(order[0] == 2 && order[2] == 0);
+  }
+
+  test_that("The complete elimination order is unchanged.") {
+    std::vector<unsigned> expected{2, 1, 0};
+    expect_true(tabulator.tabulate(none, ballots, &mte) == expected);
+  }
+}
@@ -0,0 +1,94 @@
+/*
+ * This file tests the IRVBallotIndex.
+ */
+
+#include <testthat.h>
+
+#include <vector>
+
+#include "irv_ballot.h"
+#include "irv_ballot_index.h"
+
+// The index can be computed at compile time.
+static_assert(IRVBallotIndex(4, 0, 4).size() == 1 + 4 + 12 + 24,
+              "Every ballot of 0 to 3 preferences is valid.");
+
+// Appends the valid ballots below a node to `out` in depth-first order,
+// mirroring the traversal of `IRVNode::sample`.
+void depthFirstBallots(unsigned nCandidates, unsigned minDepth,
+                       unsigned leafDepth, unsigned depth,
+                       std::vector<unsigned> &path,
+                       std::vector<IRVBallot> &out) {
+  if (depth == leafDepth) {
+    out.emplace_back(path.begin(), path.begin() + depth);
+    return;
+  }
+  if (depth >= minDepth) out.emplace_back(path.begin(), path.begin() + depth);
+  for (unsigned i = 0; i < nCandidates - depth; ++i) {
+    std::swap(path[depth], path[depth + i]);
+    depthFirstBallots(nCandidates, minDepth, leafDepth, depth + 1, path, out);
+    std::swap(path[depth], path[depth + i]);
+  }
+}
+
+context("Test ballot ids follow the order of the Dirichlet-tree.") {
+  test_that("Ids number the ballots in depth-first order.") {
+    bool consistent = true;
+    for (unsigned nCandidates : {2, 3, 5, 6}) {
+      for (unsigned minDepth = 0; minDepth < nCandidates; ++minDepth) {
+        for (unsigned maxDepth = minDepth; maxDepth <= nCandidates;
+             ++maxDepth) {
+          IRVBallotIndex index(nCandidates, minDepth, maxDepth);
+          unsigned leafDepth = std::min(maxDepth, nCandidates - 1);
+          if (minDepth > leafDepth) {
+            consistent = consistent && !index.valid();
+            continue;
+          }
+          std::vector<unsigned> path;
+          for (unsigned c = 0; c < nCandidates; ++c) path.push_back(c);
+          std::vector<IRVBallot> ballots;
+          depthFirstBallots(nCandidates, minDepth, leafDepth, 0, path,
+                            ballots);
+          consistent = consistent && index.size() == ballots.size();
+          uint64_t nVisited = 0;
+          index.forEach(path, [&](uint64_t id, const unsigned *first,
+                                  const unsigned *last) {
+            consistent = consistent && id == nVisited++ &&
+                         IRVBallot(first, last) == ballots[id];
+          });
+          consistent = consistent && nVisited == ballots.size();
+          unsigned prefs[6];
+          for (uint64_t id = 0; id < ballots.size(); ++id) {
+            unsigned n = index.unrank(id, prefs);
+            consistent = consistent && index.rank(ballots[id]) == id &&
+                         IRVBallot(prefs, prefs + n) == ballots[id];
+          }
+        }
+      }
+    }
+    expect_true(consistent);
+  }
+
+  test_that("Ballots are truncated to complete ballots.") {
+    IRVBallotIndex index(4, 0, 4);
+    IRVBallot complete(std::vector<unsigned>{2, 0, 3, 1});
+    IRVBallot implied(std::vector<unsigned>{2, 0, 3});
+    expect_true(index.rank(complete) == index.rank(implied));
+    IRVBallotIndex truncated(4, 0, 2);
+    IRVBallot prefix(std::vector<unsigned>{2, 0});
+    expect_true(truncated.rank(implied) == truncated.rank(prefix));
+  }
+
+  test_that("Ballots shorter than the minimum depth have no id.") {
+    IRVBallotIndex index(4, 2, 4);
+    IRVBallot shortBallot(std::vector<unsigned>{1});
+    expect_true(index.rank(shortBallot) == IRVBallotIndex::noIndex);
+  }
+
+  test_that("Indices with too many ballots for 64 bits are invalid.") {
+    expect_true(IRVBallotIndex(20, 0, 20).valid());
+    expect_false(IRVBallotIndex(21, 0, 21).valid());
+    expect_true(IRVBallotIndex(21, 0, 21).size() == 0);
+    expect_true(IRVBallotIndex(100, 0, 3).valid());
+  }
+}
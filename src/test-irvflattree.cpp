@@ -0,0 +1,231 @@
+/*
+ * This file tests the flattened IRV Dirichlet-tree.
+ */
+
+#include <testthat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "arena.h"
+#include "irv_flat_tree.h"
+#include "irv_node.h"
+#include "prng.h"
+
+// Returns the mean proportion of sampled ballots with first preference 0.
+double meanFirstPreference(const FlatIRVTree &flat, bool enumerated,
+                           IRVParameters *params, unsigned count,
+                           unsigned nDraws, bool *sumsToCount) {
+  PRNG engine(42);
+  SampleBuffer<IRVBallot> buffer;
+  buffer.reserveDepths(params->getNCandidates() + 1);
+  double total = 0.;
+  for (unsigned i = 0; i < nDraws; ++i) {
+    buffer.clear();
+    buffer.path = params->defaultPath();
+    if (enumerated) {
+      flat.sampleEnumerated(count, buffer.path, buffer, &engine);
+    } else {
+      flat.sample(count, buffer.path, buffer, &engine);
+    }
+    unsigned n = 0, first = 0;
+    for (const auto &[b, c] : buffer.outcomes) {
+      n += c;
+      if (b.nPreferences() > 0 && b[0] == 0) first += c;
+    }
+    *sumsToCount = *sumsToCount && n == count;
+    total += static_cast<double>(first) / count;
+  }
+  return total / nDraws;
+}
+
+context("Test valid ballots are enumerated when the tree is a Dirichlet.") {
+  test_that("Every valid ballot is enumerated exactly once.") {
+    Arena arena;
+    // Ballots of 0 to 2 preferences, and complete ballots.
+    IRVParameters full(4, 0, 4, 1., true);
+    FlatIRVTree a;
+    a.build(IRVNode::create(0, &full, &arena), &full);
+    expect_true(a.getNEnumerated() == 1 + 4 + 12 + 24);
+    // Ballots of 2 or 3 preferences.
+    IRVParameters truncated(4, 2, 3, 1., true);
+    FlatIRVTree b;
+    b.build(IRVNode::create(0, &truncated, &arena), &truncated);
+    expect_true(b.getNEnumerated() == 12 + 24);
+  }
+
+  test_that("Ballots are only enumerated for a Dirichlet distribution.") {
+    Arena arena;
+    IRVParameters params(4, 0, 4, 1., false);
+    FlatIRVTree flat;
+    flat.build(IRVNode::create(0, &params, &arena), &params);
+    expect_true(flat.getNEnumerated() == 0);
+  }
+
+  test_that("Enumerated and tree sampling have the same distribution.") {
+    Arena arena;
+    IRVParameters params(4, 0, 4, 1., true);
+    IRVNode *root = IRVNode::create(0, &params, &arena);
+    std::vector<unsigned> path = params.defaultPath();
+    root->update(IRVBallot(std::vector<unsigned>{0, 1, 2}), path, 50, &arena);
+    FlatIRVTree flat;
+    flat.build(root, &params, true);
+    bool sumsToCount = true;
+    double enumerated =
+        meanFirstPreference(flat, true, &params, 1000, 2000, &sumsToCount);
+    double tree =
+        meanFirstPreference(flat, false, &params, 20, 2000, &sumsToCount);
+    // The root has five branches with prior parameter 24, and 50 ballots
+    // were observed with first preference 0.
+    double expected = (24. + 50.) / (5 * 24. + 50.);
+    expect_true(std::fabs(enumerated - expected) < 0.01);
+    expect_true(std::fabs(tree - expected) < 0.01);
+    expect_true(sumsToCount);
+  }
+
+  test_that("Updating in place matches rebuilding the tree.") {
+    Arena arena;
+    IRVParameters params(5, 1, 4, 1., true);
+    IRVNode *root = IRVNode::create(0, &params, &arena);
+    std::vector<unsigned> path = params.defaultPath();
+    root->update(IRVBallot(std::vector<unsigned>{3, 1, 4, 0}), path, 2,
+                 &arena);
+    FlatIRVTree patched, rebuilt;
+    patched.build(root, &params);
+    // Every node on the path of these ballots already exists.
+    for (const std::vector<unsigned> &prefs :
+         {std::vector<unsigned>{3, 1}, std::vector<unsigned>{3, 1, 4, 0, 2},
+          std::vector<unsigned>{3}}) {
+      IRVBallot b(prefs);
+      root->update(b, path, 3, &arena);
+      expect_true(patched.update(b, path, 3));
+    }
+    rebuilt.build(root, &params);
+    PRNG a(7), b(7);
+    SampleBuffer<IRVBallot> bufferA, bufferB;
+    bufferA.reserveDepths(6);
+    bufferB.reserveDepths(6);
+    patched.sampleEnumerated(1000, path, bufferA, &a);
+    rebuilt.sampleEnumerated(1000, path, bufferB, &b);
+    expect_true(bufferA.outcomes == bufferB.outcomes);
+  }
+}
+
+context("Test wide nodes store only their observed branches.") {
+  // Draws a number of random ballots of up to 3 preferences.
+  auto randomBallots = [](unsigned n, unsigned nCandidates, PRNG *engine) {
+    std::vector<IRVBallot> out;
+    std::vector<unsigned> prefs(nCandidates);
+    for (unsigned i = 0; i < n; ++i) {
+      for (unsigned c = 0; c < nCandidates; ++c) prefs[c] = c;
+      std::shuffle(prefs.begin(), prefs.end(), *engine);
+      out.emplace_back(prefs.begin(), prefs.begin() + 1 + (*engine)() % 3);
+    }
+    return out;
+  };
+
+  test_that("Sparse nodes hold the same parameters as dense nodes.") {
+    Arena arena;
+    IRVParameters params(20, 0, 20);
+    IRVNode *root = IRVNode::create(0, &params, &arena);
+    std::vector<unsigned> path = params.defaultPath();
+    std::vector<unsigned> firsts(20, 0);
+    root->update(IRVBallot(std::vector<unsigned>{7}), path, 2, &arena);
+    root->update(IRVBallot(std::vector<unsigned>{3}), path, 1, &arena);
+    firsts[7] = 2;
+    firsts[3] = 1;
+    expect_true(root->isSparse());
+    bool same = true;
+    for (unsigned c = 0; c < 20; ++c) same = same && root->getA(c) == firsts[c];
+    expect_true(same);
+    // Observing most of the branches makes the node dense.
+    for (unsigned c = 0; c < 12; ++c) {
+      root->update(IRVBallot(std::vector<unsigned>{c}), path, 1, &arena);
+      ++firsts[c];
+    }
+    root->update(IRVBallot(std::vector<unsigned>{}), path, 4, &arena);
+    expect_false(root->isSparse());
+    for (unsigned c = 0; c < 20; ++c) same = same && root->getA(c) == firsts[c];
+    expect_true(same);
+    expect_true(root->getA(20) == 4);
+    expect_true(root->getChild(7) != nullptr && root->getChild(19) == nullptr);
+  }
+
+  test_that("Sparse nodes sample as the flattened tree does.") {
+    Arena arena;
+    IRVParameters params(24, 0, 24);
+    IRVNode *root = IRVNode::create(0, &params, &arena);
+    std::vector<unsigned> path = params.defaultPath();
+    PRNG engine(3);
+    for (const IRVBallot &b : randomBallots(50, 24, &engine))
+      root->update(b, path, 1 + engine() % 5, &arena);
+    FlatIRVTree flat;
+    flat.build(root, &params);
+    PRNG a(9), b(9);
+    SampleBuffer<IRVBallot> bufferA, bufferB;
+    bufferA.reserveDepths(25);
+    bufferB.reserveDepths(25);
+    bufferA.path = bufferB.path = params.defaultPath();
+    root->sample(500, bufferA.path, bufferA, &a);
+    flat.sample(500, bufferB.path, bufferB, &b);
+    expect_true(bufferA.outcomes == bufferB.outcomes);
+  }
+
+  test_that("Sparse nodes are updated in place only where stored.") {
+    Arena arena;
+    IRVParameters params(30, 0, 30);
+    IRVNode *root = IRVNode::create(0, &params, &arena);
+    std::vector<unsigned> path = params.defaultPath();
+    PRNG engine(5);
+    std::vector<IRVBallot> ballots = randomBallots(6, 30, &engine);
+    for (const IRVBallot &b : ballots) root->update(b, path, 1, &arena);
+    FlatIRVTree patched, rebuilt;
+    patched.build(root, &params);
+    for (const IRVBallot &b : ballots) {
+      root->update(b, path, 2, &arena);
+      expect_true(patched.update(b, path, 2));
+    }
+    rebuilt.build(root, &params);
+    PRNG a(11), b(11);
+    SampleBuffer<IRVBallot> bufferA, bufferB;
+    bufferA.reserveDepths(31);
+    bufferB.reserveDepths(31);
+    patched.sample(1000, path, bufferA, &a);
+    rebuilt.sample(1000, path, bufferB, &b);
+    expect_true(bufferA.outcomes == bufferB.outcomes);
+    // A first preference which was never observed is not stored.
+    unsigned unseen = 0;
+    while (root->getChild(unseen) != nullptr) ++unseen;
+    expect_false(patched.update(IRVBallot(std::vector<unsigned>{unseen, 0}),
+                                path, 1));
+  }
+}
+
+context("Test ballots longer than the maximum depth are flattened.") {
+  test_that("Nodes below the maximum depth are not flattened.") {
+    Arena arena;
+    IRVParameters params(5, 0, 3);
+    IRVNode *root = IRVNode::create(0, &params, &arena);
+    std::vector<unsigned> path = params.defaultPath();
+    IRVBallot complete(std::vector<unsigned>{4, 3, 2, 1, 0});
+    root->update(complete, path, 2, &arena);
+    FlatIRVTree patched, rebuilt;
+    patched.build(root, &params);
+    // Patching a ballot longer than the maximum depth succeeds in place.
+    root->update(complete, path, 3, &arena);
+    expect_true(patched.update(complete, path, 3));
+    rebuilt.build(root, &params);
+    PRNG a(13), b(13);
+    SampleBuffer<IRVBallot> bufferA, bufferB;
+    bufferA.reserveDepths(6);
+    bufferB.reserveDepths(6);
+    patched.sample(500, path, bufferA, &a);
+    rebuilt.sample(500, path, bufferB, &b);
+    bool truncated = true;
+    for (const auto &[ballot, count] : bufferB.outcomes)
+      truncated = truncated && ballot.nPreferences() <= 3;
+    expect_true(bufferA.outcomes == bufferB.outcomes);
+    expect_true(truncated);
+  }
+}
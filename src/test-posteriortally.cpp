@@ -0,0 +1,79 @@
+/*
+ * This file tests the PosteriorTally.
+ */
+
+#include <testthat.h>
+
+#include <cmath>
+#include <vector>
+
+#include "posterior_tally.h"
+
+context("Test PosteriorTally accumulates election results.") {
+  test_that("Winners are counted from the end of the elimination order.") {
+    PosteriorTally t(4, 2);
+    t.add({0, 1, 2, 3});
+    t.add({3, 0, 1, 2});
+    std::vector<uint64_t> expected{0, 1, 2, 1};
+    expect_true(t.getWins() == expected);
+    expect_true(t.getNElections() == 2);
+    expect_true(t.getOrders().empty());
+  }
+
+  test_that("Elimination orders are recorded when requested.") {
+    PosteriorTally t(3, 1, true);
+    t.add({0, 1, 2});
+    t.add({1, 0, 2});
+    t.add({0, 1, 2});
+    IRVBallot first(std::vector<unsigned>{0, 1, 2});
+    IRVBallot second(std::vector<unsigned>{1, 0, 2});
+    expect_true(t.getOrders().size() == 2);
+    expect_true(t.getOrders().count(first) == 2);
+    expect_true(t.getOrders().count(second) == 1);
+  }
+
+  test_that("Merging tallies matches tallying every election together.") {
+    PosteriorTally a(3, 1, true), b(3, 1, true), all(3, 1, true);
+    std::vector<std::vector<unsigned>> orders{
+        {0, 1, 2}, {2, 1, 0}, {1, 2, 0}, {0, 1, 2}, {2, 0, 1}};
+    for (unsigned i = 0; i < orders.size(); ++i) {
+      (i % 2 ? a : b).add(orders[i]);
+      all.add(orders[i]);
+    }
+    a.merge(b);
+    bool same = a.getOrders().size() == all.getOrders().size();
+    for (const auto &[order, count] : all.getOrders())
+      same = same && a.getOrders().count(order) == count;
+    expect_true(a.getWins() == all.getWins());
+    expect_true(a.getNElections() == all.getNElections());
+    expect_true(same);
+  }
+
+  test_that("Precedence counts each pair of candidates once per election.") {
+    PosteriorTally t(3, 1, true);
+    t.add({0, 1, 2});
+    t.add({2, 0, 1});
+    const std::vector<uint64_t> &p = t.getPrecedence();
+    // p[a * 3 + b] counts elections with a eliminated before b.
+    expect_true(p[0 * 3 + 1] == 2 && p[1 * 3 + 0] == 0);
+    expect_true(p[0 * 3 + 2] == 1 && p[2 * 3 + 0] == 1);
+    expect_true(p[1 * 3 + 2] == 1 && p[2 * 3 + 1] == 1);
+  }
+
+  test_that("Tally quantiles only count standing candidates.") {
+    PosteriorTally t(3, 1, false, 10);
+    // Two rounds of tallies for candidates 0, 1 and 2.
+    std::vector<unsigned> first{2, 3, 5, 0, 5, 5};
+    std::vector<unsigned> second{4, 3, 3, 7, 0, 3};
+    t.add({0, 1, 2}, &first);
+    t.add({1, 2, 0}, &second);
+    expect_true(t.tallyQuantile(0, 0, 0.5) == 2);
+    expect_true(t.tallyQuantile(0, 0, 1) == 4);
+    expect_true(t.tallyQuantile(1, 2, 0.5) == 3);
+    expect_true(t.tallyQuantile(1, 2, 1) == 5);
+    // Candidate 1 is eliminated in the first round of the second election.
+    expect_true(t.tallyQuantile(1, 1, 0.5) == 5);
+    PosteriorTally empty(3, 1, false, 10);
+    expect_true(std::isnan(empty.tallyQuantile(0, 0, 0.5)));
+  }
+}
@@ -0,0 +1,104 @@
+/*
+ * This file tests the pseudo-random number generators.
+ */
+
+#include <testthat.h>
+
+#include <vector>
+
+#include "prng.h"
+
+context("Test PRNG engines are reproducible.") {
+  std::vector<PRNG::Kind> kinds{PRNG::Kind::MT19937, PRNG::Kind::Xoshiro256pp,
+                                PRNG::Kind::PCG64, PRNG::Kind::Philox4x32};
+
+  test_that("The same seed gives the same stream.") {
+    bool same = true;
+    for (PRNG::Kind kind : kinds) {
+      PRNG a(42, kind), b(42, kind);
+      // Cross the refill boundary of the output buffer.
+      for (unsigned i = 0; i < 200; ++i) same = same && a() == b();
+    }
+    expect_true(same);
+  }
+
+  test_that("Reseeding restarts the stream.") {
+    bool same = true;
+    for (PRNG::Kind kind : kinds) {
+      PRNG a(7, kind);
+      std::vector<PRNG::result_type> first;
+      for (unsigned i = 0; i < 100; ++i) first.push_back(a());
+      a.seed(7);
+      for (unsigned i = 0; i < 100; ++i) same = same && a() == first[i];
+    }
+    expect_true(same);
+  }
+
+  test_that("Copies continue the stream independently.") {
+    bool same = true;
+    for (PRNG::Kind kind : kinds) {
+      PRNG a(11, kind);
+      for (unsigned i = 0; i < 100; ++i) a();
+      PRNG b(a), c(1, kind);
+      c = a;
+      // Advancing the original does not advance its' copies.
+      std::vector<PRNG::result_type> next;
+      for (unsigned i = 0; i < 200; ++i) next.push_back(a());
+      for (unsigned i = 0; i < 200; ++i)
+        same = same && b() == next[i] && c() == next[i];
+      same = same && b.getKind() == kind;
+    }
+    expect_true(same);
+  }
+
+  test_that("Different engines give different streams.") {
+    PRNG mt(1, PRNG::Kind::MT19937), xo(1, PRNG::Kind::Xoshiro256pp),
+        pcg(1, PRNG::Kind::PCG64);
+    bool differ = false;
+    for (unsigned i = 0; i < 10; ++i) {
+      PRNG::result_type x = mt(), y = xo(), z = pcg();
+      differ = differ || (x != y && y != z && x != z);
+    }
+    expect_true(differ);
+  }
+
+  test_that("The Mersenne Twister stream matches std::mt19937.") {
+    std::seed_seq ss1{1, 2, 3}, ss2{1, 2, 3};
+    PRNG a{};
+    a.seed(ss1);
+    std::mt19937 b(ss2);
+    bool same = true;
+    for (unsigned i = 0; i < 200; ++i) same = same && a() == b();
+    expect_true(same);
+  }
+}
+
+context("Test counter-based PRNG streams.") {
+  std::vector<PRNG::Kind> kinds{PRNG::Kind::MT19937, PRNG::Kind::Xoshiro256pp,
+                                PRNG::Kind::PCG64, PRNG::Kind::Philox4x32};
+
+  test_that("Philox4x32-10 matches the Random123 known answers.") {
+    Philox4x32 p;
+    uint32_t out[4];
+    p.seed(0, 0);
+    p.generate(out);
+    expect_true(out[0] == 0x6627e8d5u && out[1] == 0xe169c58du &&
+                out[2] == 0xbc57ac4cu && out[3] == 0x9b00dbd8u);
+  }
+
+  test_that("Streams are reproducible and distinct.") {
+    bool reproducible = true, distinct = false;
+    for (PRNG::Kind kind : kinds) {
+      PRNG a(1, kind), b(2, kind);
+      a.seedStream(99, 3);
+      b.seedStream(99, 3);
+      for (unsigned i = 0; i < 100; ++i)
+        reproducible = reproducible && a() == b();
+      a.seedStream(99, 3);
+      b.seedStream(99, 4);
+      for (unsigned i = 0; i < 10; ++i) distinct = distinct || a() != b();
+    }
+    expect_true(reproducible);
+    expect_true(distinct);
+  }
+}
@@ -28,3 +28,42 @@ context("Test RDirichletTree constructor and destructor.") {
         createAndDeleteTree(candidates, minDepth, maxDepth, a0, vd, seed));
   }
 }
+
+context("Test ballots are read from an R integer matrix.") {
+  // Three ballots of lengths 2, 0 and 3, ending at the first NA.
+  Rcpp::IntegerMatrix ballots(3, 3);
+  int entries[] = {2, NA_INTEGER, 3, 1, NA_INTEGER, 1, NA_INTEGER, 2, 2};
+  for (unsigned k = 0; k < 9; ++k) ballots(k % 3, k / 3) = entries[k];
+
+  test_that("Ballots end at the first NA and keep their counts.") {
+    Rcpp::IntegerVector counts{4, 1, 2};
+    std::vector<IRVBallotCount> bcs = parseBallotMatrix(ballots, counts, 3);
+    expect_true(bcs.size() == 3);
+    expect_true(bcs[0].first == IRVBallot(std::vector<unsigned>{1, 0}));
+    expect_true(bcs[1].first.nPreferences() == 0);
+    expect_true(bcs[2].first == IRVBallot(std::vector<unsigned>{2, 0, 1}));
+    expect_true(bcs[0].second == 4 && bcs[2].second == 2);
+  }
+
+  test_that("Ballots with a count of zero are skipped.") {
+    Rcpp::IntegerVector counts{0, 1, 2};
+    std::vector<IRVBallotCount> bcs = parseBallotMatrix(ballots, counts, 3);
+    expect_true(bcs.size() == 2);
+    expect_true(bcs[0].first.nPreferences() == 0);
+  }
+
+  test_that("Invalid ballots raise an error.") {
+    Rcpp::IntegerVector counts{1, 1, 1};
+    // Candidate 3 is out of range when there are only two candidates.
+    expect_error(parseBallotMatrix(ballots, counts, 2));
+    Rcpp::IntegerVector tooFew{1, 1};
+    expect_error(parseBallotMatrix(ballots, tooFew, 3));
+    Rcpp::IntegerVector negative{1, -1, 1};
+    expect_error(parseBallotMatrix(ballots, negative, 3));
+    Rcpp::IntegerMatrix repeated(1, 2);
+    repeated(0, 0) = 1;
+    repeated(0, 1) = 1;
+    Rcpp::IntegerVector one{1};
+    expect_error(parseBallotMatrix(repeated, one, 3));
+  }
+}
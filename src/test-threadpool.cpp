@@ -0,0 +1,108 @@
+/*
+ * This file tests the ThreadPool.
+ */
+
+#include <sys/wait.h>
+#include <testthat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "thread_pool.h"
+
+context("Test the thread pool executes every task once.") {
+  test_that("Every task is executed exactly once.") {
+    ThreadPool pool(4);
+    bool once = true;
+    // Reuse the pool for several jobs of different shapes.
+    for (unsigned nTasks : {0u, 1u, 7u, 1000u}) {
+      for (unsigned chunkSize : {1u, 3u, 64u}) {
+        std::vector<std::atomic<unsigned>> counts(nTasks);
+        pool.run(nTasks, chunkSize,
+                 [&](unsigned worker, unsigned begin, unsigned end) {
+                   for (unsigned i = begin; i < end; ++i) ++counts[i];
+                 });
+        for (auto &c : counts) once = once && c == 1;
+      }
+    }
+    expect_true(once);
+  }
+
+  test_that("Statistics account for every task.") {
+    ThreadPool pool(3);
+    // Make the first tasks much more expensive, so that work is stolen.
+    std::atomic<unsigned> sink{0};
+    pool.run(300, 1, [&](unsigned worker, unsigned begin, unsigned end) {
+      for (unsigned i = begin; i < end; ++i) {
+        unsigned n = i < 100 ? 100000 : 10;
+        for (unsigned j = 0; j < n; ++j) sink += j;
+      }
+    });
+    uint64_t total = 0;
+    for (const WorkerStats &s : pool.getStats()) total += s.tasks;
+    expect_true(pool.getStats().size() == 3);
+    expect_true(total == 300);
+  }
+
+  test_that("The pool can be resized between jobs.") {
+    ThreadPool pool(1);
+    bool once = true;
+    for (unsigned nWorkers : {1u, 4u, 2u, 2u}) {
+      pool.resize(nWorkers);
+      std::vector<std::atomic<unsigned>> counts(100);
+      pool.run(100, 1, [&](unsigned worker, unsigned begin, unsigned end) {
+        for (unsigned i = begin; i < end; ++i) ++counts[i];
+      });
+      for (auto &c : counts) once = once && c == 1;
+      once = once && pool.size() == nWorkers;
+    }
+    expect_true(once);
+  }
+
+  test_that("Exceptions are rethrown by the calling thread.") {
+    ThreadPool pool(4);
+    bool thrown = false;
+    try {
+      pool.run(100, 1, [&](unsigned worker, unsigned begin, unsigned end) {
+        if (begin == 42) throw std::runtime_error("task failed");
+      });
+    } catch (const std::runtime_error &e) {
+      thrown = true;
+    }
+    expect_true(thrown);
+    // The pool is still usable afterwards.
+    std::atomic<unsigned> n{0};
+    pool.run(10, 1, [&](unsigned worker, unsigned begin, unsigned end) {
+      n += end - begin;
+    });
+    expect_true(n == 10);
+  }
+
+  test_that("A pool inherited through a fork can be destroyed.") {
+    ThreadPool *pool = new ThreadPool(1);
+    pool->resize(4);
+    std::atomic<unsigned> n{0};
+    pool->run(100, 1, [&](unsigned worker, unsigned begin, unsigned end) {
+      n += end - begin;
+    });
+    pid_t pid = fork();
+    if (pid == 0) {
+      // Joining the parent's threads would block forever, so the child is
+      // killed if the destructor does not return promptly.
+      alarm(10);
+      delete pool;
+      _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    expect_true(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    // The parent's threads are unaffected.
+    pool->run(100, 1, [&](unsigned worker, unsigned begin, unsigned end) {
+      n += end - begin;
+    });
+    expect_true(n == 200);
+    delete pool;
+  }
+}
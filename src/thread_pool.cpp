@@ -0,0 +1,185 @@
+/******************************************************************************
+ * File:             thread_pool.cpp
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      This file implements the ThreadPool as outlined in
+ *                   `thread_pool.h`.
+ *****************************************************************************/
+#include "thread_pool.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+
+// Packs a range of chunks into a single word.
+static uint64_t pack(uint64_t begin, uint64_t end) { return begin << 32 | end; }
+
+ThreadPool::ThreadPool(unsigned nWorkers) { resize(nWorkers); }
+
+ThreadPool::~ThreadPool() { stop(); }
+
+void ThreadPool::resize(unsigned nWorkers) {
+  checkFork();
+  nWorkers = std::max(nWorkers, 1u);
+  if (ranges && nWorkers == size()) return;
+  stop();
+  ranges.reset(new Range[nWorkers]);
+  stats.assign(nWorkers, WorkerStats{});
+  start(nWorkers - 1);
+}
+
+void ThreadPool::start(unsigned nThreads) {
+  owner = getpid();
+  // The threads are started between jobs, so they begin waiting for the job
+  // after the current generation.
+  for (unsigned i = 0; i < nThreads; ++i)
+    threads.emplace_back(&ThreadPool::threadLoop, this, i, generation);
+}
+
+void ThreadPool::stop() {
+  // Threads inherited through a fork cannot be joined, as they never run in
+  // this process.
+  if (abandonInherited()) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  jobReady.notify_all();
+  for (std::thread &t : threads) t.join();
+  threads.clear();
+  stopping = false;
+}
+
+bool ThreadPool::abandonInherited() {
+  if (threads.empty() || owner == getpid()) return false;
+  // The threads exist only in the parent, so they can be neither signalled
+  // nor joined. The synchronisation primitives may have been held by one of
+  // them at the time of the fork, so they are reinitialised.
+  for (std::thread &t : threads) t.detach();
+  threads.clear();
+  new (&mutex) std::mutex();
+  new (&jobReady) std::condition_variable();
+  new (&jobDone) std::condition_variable();
+  return true;
+}
+
+void ThreadPool::checkFork() {
+  unsigned nThreads = threads.size();
+  // Start new threads for this process in place of any inherited ones.
+  if (abandonInherited()) start(nThreads);
+}
+
+void ThreadPool::threadLoop(unsigned worker, uint64_t seen) {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      jobReady.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping) return;
+      seen = generation;
+    }
+    work(worker);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--nBusy == 0) jobDone.notify_one();
+    }
+  }
+}
+
+bool ThreadPool::pop(unsigned worker, unsigned &chunk) {
+  std::atomic<uint64_t> &bounds = ranges[worker].bounds;
+  uint64_t b = bounds.load();
+  while (true) {
+    uint64_t begin = b >> 32, end = b & 0xFFFFFFFF;
+    if (begin >= end) return false;
+    if (bounds.compare_exchange_weak(b, pack(begin + 1, end))) {
+      chunk = begin;
+      return true;
+    }
+  }
+}
+
+bool ThreadPool::steal(unsigned worker) {
+  unsigned nWorkers = size();
+  for (unsigned i = 1; i < nWorkers; ++i) {
+    std::atomic<uint64_t> &victim = ranges[(worker + i) % nWorkers].bounds;
+    uint64_t b = victim.load();
+    while (true) {
+      uint64_t begin = b >> 32, end = b & 0xFFFFFFFF;
+      if (begin >= end) break;
+      // Take the back half, leaving the victim the chunk it is likely to
+      // take next.
+      uint64_t mid = end - (end - begin + 1) / 2;
+      if (victim.compare_exchange_weak(b, pack(begin, mid))) {
+        // Only the owner refills an empty range, and thieves skip empty
+        // ranges, so a plain store suffices. Chunks are never handed out
+        // twice, so the new range cannot be mistaken for an earlier one.
+        ranges[worker].bounds.store(pack(mid, end));
+        ++stats[worker].steals;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void ThreadPool::work(unsigned worker) {
+  typedef std::chrono::steady_clock clock;
+  WorkerStats &s = stats[worker];
+  unsigned chunk;
+  while (pop(worker, chunk) || (steal(worker) && pop(worker, chunk))) {
+    if (failed.load(std::memory_order_relaxed)) continue;
+    unsigned begin = chunk * chunkSize;
+    unsigned end = std::min(begin + chunkSize, nTasks);
+    clock::time_point t0 = clock::now();
+    try {
+      (*job)(worker, begin, end);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error) error = std::current_exception();
+      failed = true;
+    }
+    s.busySeconds += std::chrono::duration<double>(clock::now() - t0).count();
+    s.tasks += end - begin;
+  }
+}
+
+void ThreadPool::run(unsigned nTasks_, unsigned chunkSize_, const Job &job_) {
+  checkFork();
+  typedef std::chrono::steady_clock clock;
+  clock::time_point t0 = clock::now();
+  unsigned nWorkers = size();
+  stats.assign(nWorkers, WorkerStats{});
+
+  // Deal out an even share of the chunks to each worker.
+  chunkSize = std::max(chunkSize_, 1u);
+  nTasks = nTasks_;
+  uint64_t nChunks = (uint64_t{nTasks} + chunkSize - 1) / chunkSize;
+  for (unsigned i = 0; i < nWorkers; ++i)
+    ranges[i].bounds.store(
+        pack(nChunks * i / nWorkers, nChunks * (i + 1) / nWorkers));
+
+  job = &job_;
+  failed = false;
+  error = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    nBusy = nWorkers - 1;
+    ++generation;
+  }
+  jobReady.notify_all();
+
+  // The calling thread works on the final share.
+  work(nWorkers - 1);
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [&] { return nBusy == 0; });
+  }
+  job = nullptr;
+  wallSeconds = std::chrono::duration<double>(clock::now() - t0).count();
+
+  if (error) std::rethrow_exception(error);
+}
@@ -0,0 +1,180 @@
+/******************************************************************************
+ * File:             thread_pool.h
+ *
+ * Author:           Floyd Everest <me@floydeverest.com>
+ * Created:          10/16/26
+ * Description:      This file declares the ThreadPool, a set of long-lived
+ *                   worker threads which execute a range of tasks in chunks.
+ *                   Each worker begins with an even share of the chunks, and
+ *                   workers which run out steal half of the remaining chunks
+ *                   of another worker, so that expensive tasks do not leave
+ *                   the other threads idle.
+ *****************************************************************************/
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*! \brief The work done by one thread during a call to `ThreadPool::run`.
+ */
+struct WorkerStats {
+  // The number of tasks executed.
+  uint64_t tasks = 0;
+
+  // The number of times chunks were stolen from another worker.
+  uint64_t steals = 0;
+
+  // The time spent executing tasks, in seconds.
+  double busySeconds = 0;
+};
+
+class ThreadPool {
+ public:
+  /*! \brief Executes the tasks in [begin, end) on the given worker.
+   */
+  typedef std::function<void(unsigned worker, unsigned begin, unsigned end)>
+      Job;
+
+ private:
+  // The range of chunks yet to be executed by a worker, packed as
+  // (begin << 32) | end so that it can be updated atomically. The owner takes
+  // chunks from the front while thieves take from the back. Each range is
+  // padded to a cache line so that workers do not contend on neighbours.
+  struct alignas(64) Range {
+    std::atomic<uint64_t> bounds{0};
+  };
+
+  // The persistent threads. The thread calling `run` acts as the final
+  // worker, so there is one fewer thread than workers.
+  std::vector<std::thread> threads{};
+
+  // The process which started the threads. Threads do not survive a fork, so
+  // a forked child (e.g. from `parallel::mclapply`) must start its' own.
+  long owner = 0;
+
+  // The chunks owned by each worker.
+  std::unique_ptr<Range[]> ranges{};
+
+  // The statistics for each worker from the most recent call to `run`.
+  std::vector<WorkerStats> stats{};
+
+  // The wall-clock duration of the most recent call to `run`, in seconds.
+  double wallSeconds = 0;
+
+  // The current job, and its' division into chunks.
+  const Job *job = nullptr;
+  unsigned nTasks = 0;
+  unsigned chunkSize = 1;
+
+  // Synchronises the hand-over of jobs to the threads. Every job increments
+  // the generation, which the idle threads wait on.
+  std::mutex mutex{};
+  std::condition_variable jobReady{};
+  std::condition_variable jobDone{};
+  uint64_t generation = 0;
+  unsigned nBusy = 0;
+  bool stopping = false;
+
+  // Set once a task has thrown, so that the remaining chunks are skipped.
+  std::atomic<bool> failed{false};
+  std::exception_ptr error{};
+
+  /*! \brief The loop executed by each persistent thread.
+   *
+   * \param worker The index of the worker.
+   *
+   * \param seen The generation of the last job the thread has seen.
+   */
+  void threadLoop(unsigned worker, uint64_t seen);
+
+  /*! \brief Executes chunks until none remain in any worker's range.
+   */
+  void work(unsigned worker);
+
+  /*! \brief Takes the next chunk from the front of a worker's own range.
+   *
+   * \return Whether a chunk was taken.
+   */
+  bool pop(unsigned worker, unsigned &chunk);
+
+  /*! \brief Moves half of the chunks of another worker to this worker.
+   *
+   * \return Whether any chunks were stolen.
+   */
+  bool steal(unsigned worker);
+
+  /*! \brief Starts the given number of persistent threads.
+   */
+  void start(unsigned nThreads);
+
+  /*! \brief Stops and joins the persistent threads, or abandons them if they
+   * were inherited through a fork.
+   */
+  void stop();
+
+  /*! \brief Abandons the threads if the pool was inherited through a fork.
+   *
+   * \return Whether any threads were abandoned.
+   */
+  bool abandonInherited();
+
+  /*! \brief Restarts the threads if the pool was inherited through a fork.
+   */
+  void checkFork();
+
+ public:
+  // Constructor.
+  ThreadPool(unsigned nWorkers = 1);
+
+  // Destructor.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /*! \brief Gets the number of workers, including the calling thread.
+   */
+  unsigned size() const { return threads.size() + 1; }
+
+  /*! \brief Sets the number of workers, restarting the threads if the number
+   * has changed.
+   *
+   * \param nWorkers The number of workers, including the calling thread.
+   */
+  void resize(unsigned nWorkers);
+
+  /*! \brief Executes every task in [0, nTasks) and blocks until they are
+   * complete.
+   *
+   *  Tasks are grouped into chunks of consecutive tasks, and each chunk is
+   * executed by a single call to the job. The job may be invoked from any
+   * worker, in any order, and concurrently with itself. If a task throws, the
+   * remaining chunks are abandoned and the first exception is rethrown.
+   *
+   * \param nTasks_ The number of tasks.
+   *
+   * \param chunkSize_ The number of tasks per chunk.
+   *
+   * \param job_ The job which executes a chunk of tasks.
+   */
+  void run(unsigned nTasks_, unsigned chunkSize_, const Job &job_);
+
+  /*! \brief Gets the statistics of each worker from the most recent call to
+   * `run`.
+   */
+  const std::vector<WorkerStats> &getStats() const { return stats; }
+
+  /*! \brief Gets the duration of the most recent call to `run`, in seconds.
+   */
+  double getWallSeconds() const { return wallSeconds; }
+};
+
+#endif /* THREAD_POOL_H */
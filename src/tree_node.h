@@ -20,6 +20,10 @@
 
 #include <list>
 #include <random>
+#include <vector>
+
+#include "arena.h"
+#include "prng.h"
 
 class Parameters {
  public:
@@ -31,6 +35,52 @@ class Parameters {
   std::vector<unsigned> defaultPath();
 };
 
+/*! \brief Reusable storage for outcomes sampled from a Dirichlet-tree.
+ *
+ *  Sampling writes (outcome, count) pairs into `outcomes`, and uses the
+ * per-depth scratch vectors for the intermediate Dirichlet-multinomial draws.
+ * Once the buffer has been used for a draw, subsequent draws of a similar size
+ * reuse the same storage and do not allocate.
+ */
+template <typename Outcome>
+class SampleBuffer {
+ public:
+  // The sampled (outcome, count) pairs.
+  std::vector<std::pair<Outcome, unsigned>> outcomes{};
+
+  // Scratch space for the Dirichlet parameters at each depth.
+  std::vector<std::vector<double>> as{};
+
+  // Scratch space for the Dirichlet probabilities at each depth.
+  std::vector<std::vector<double>> ps{};
+
+  // Scratch space for the multinomial counts at each depth.
+  std::vector<std::vector<unsigned>> counts{};
+
+  // The traversal path shared by every level of the recursion. Each node
+  // permutes it in place to describe its' children, and restores it before
+  // returning.
+  std::vector<unsigned> path{};
+
+  /*! \brief Ensures scratch space exists for a tree of the given height.
+   *
+   *  The per-depth scratch must be allocated before traversal begins, since
+   * resizing it would invalidate references held further up the tree.
+   *
+   * \param nDepths The number of depths in the tree.
+   */
+  void reserveDepths(size_t nDepths) {
+    if (as.size() >= nDepths) return;
+    as.resize(nDepths);
+    ps.resize(nDepths);
+    counts.resize(nDepths);
+  }
+
+  /*! \brief Removes the sampled outcomes, retaining allocated storage.
+   */
+  void clear() { outcomes.clear(); }
+};
+
 template <typename Outcome, typename ChildNode, class Parameters>
 class TreeNode {
  protected:
@@ -58,7 +108,9 @@ class TreeNode {
   ChildNode **children;
 
  public:
-  // Destructor.
+  // Destructor. Nodes are typically allocated from an Arena, in which case
+  // the destructor is never called and the memory is released by rewinding
+  // the arena.
   virtual ~TreeNode(){};
 
   /*! \brief Samples count data from the sub-tree.
@@ -74,16 +126,17 @@ class TreeNode {
    * \param path The path to this node. This can vary between different
    * types of TreeNodes. For example, if we consider an IRV tree with
    * complete ballots, a path could be a partial permutation which (at a
-   * leaf) will realize a complete IRV ballot.
+   * leaf) will realize a complete IRV ballot. The path may be modified during
+   * traversal, but it is restored before returning.
    *
-   * \param engine A PRNG used for sampling.
+   * \param buffer The buffer to append (outcome, count) pairs to,
+   * corresponding to realizations of the underlying stochastic process
+   * possible from the starting point that this node represents.
    *
-   * \return A list of (outcome, count) pairs corresponding to realizations of
-   * the underlying stochastic process possible from the starting point that
-   * this node represents.
+   * \param engine A PRNG used for sampling.
    */
-  virtual std::list<std::pair<Outcome, unsigned>> sample(
-      unsigned count, std::vector<unsigned> path, std::mt19937 *engine) = 0;
+  virtual void sample(unsigned count, std::vector<unsigned> &path,
+                      SampleBuffer<Outcome> &buffer, PRNG *engine) = 0;
 
   /*! \brief Updates sub-tree parameters to obtain a posterior.
    *
@@ -93,12 +146,37 @@ class TreeNode {
    *
    * \param o The outcome to observe.
    *
-   * \param path The path to the current node.
+   * \param path The path to the current node. The path may be modified
+   * during traversal, but it is restored before returning.
    *
    * \param count The number of times to observe o.
+   *
+   * \param arena The arena in which to allocate any newly created nodes.
+   */
+  virtual void update(const Outcome &o, std::vector<unsigned> &path,
+                      unsigned count, Arena *arena) = 0;
+
+  /*! \brief Updates sub-tree parameters with a batch of outcomes.
+   *
+   *  Equivalent to calling `update` for each outcome in the range, except
+   * that outcomes which share a path below this node are traversed together,
+   * updating the parameters along the shared path once with their combined
+   * count.
+   *
+   * \param first A pointer to the first (outcome, count) pair. The range must
+   * be sorted such that outcomes sharing a path are adjacent, and every
+   * outcome must pass through this node.
+   *
+   * \param last A pointer past the last (outcome, count) pair.
+   *
+   * \param path The path to the current node. The path may be modified
+   * during traversal, but it is restored before returning.
+   *
+   * \param arena The arena in which to allocate any newly created nodes.
    */
-  virtual void update(const Outcome &o, std::vector<unsigned> path,
-                      unsigned count) = 0;
+  virtual void update(const std::pair<Outcome, unsigned> *first,
+                      const std::pair<Outcome, unsigned> *last,
+                      std::vector<unsigned> &path, Arena *arena) = 0;
 };
 
 #endif /* NODE_H */